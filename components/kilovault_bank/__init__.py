@@ -0,0 +1,46 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.const import CONF_ID
+from esphome.components.kilovault_bms_ble import KilovaultBmsBle
+
+# Aggregates several kilovault_bms_ble batteries running in parallel into one bank.
+
+CODEOWNERS = ["@syssi"]
+
+DEPENDENCIES = ["kilovault_bms_ble"]
+
+AUTO_LOAD = ["sensor"]
+
+MULTI_CONF = True
+
+CONF_KILOVAULT_BANK_ID = "kilovault_bank_id"
+CONF_BATTERIES = "batteries"
+CONF_STALE_TIMEOUT = "stale_timeout"
+
+kilovault_bank_ns = cg.esphome_ns.namespace("kilovault_bank")
+
+KilovaultBank = kilovault_bank_ns.class_("KilovaultBank", cg.PollingComponent)
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(KilovaultBank),
+        cv.Required(CONF_BATTERIES): cv.All(
+            cv.ensure_list(cv.use_id(KilovaultBmsBle)), cv.Length(min=1)
+        ),
+        # A battery that has not sent a frame for this long is left out of the bank values
+        cv.Optional(
+            CONF_STALE_TIMEOUT, default="60s"
+        ): cv.positive_time_period_milliseconds,
+    }
+).extend(cv.polling_component_schema("10s"))
+
+
+# Code Generation
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    for battery_id in config[CONF_BATTERIES]:
+        battery = await cg.get_variable(battery_id)
+        cg.add(var.add_battery(battery))
+    cg.add(var.set_stale_timeout(config[CONF_STALE_TIMEOUT]))
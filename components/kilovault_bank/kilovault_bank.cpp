@@ -0,0 +1,158 @@
+#include "kilovault_bank.h"
+#include "esphome/core/log.h"
+#include "esphome/core/hal.h"
+
+#ifdef USE_ESP32
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace esphome {
+namespace kilovault_bank {
+
+static const char *const TAG = "kilovault_bank";
+
+/* ========================================================================= */
+/*
+  Subscribes to the status callback of every battery. The batteries vector is not
+  resized after this, so the references captured here stay valid.
+*/
+void KilovaultBank::setup() {
+  for (auto &battery : this->batteries_) {
+    battery.battery->add_on_status_callback(
+        [this, &battery](const StatusData &status_data) { this->on_status_(battery, status_data); });
+  }
+}
+
+/* ========================================================================= */
+/*
+  Replaces the contribution of a battery with the values of its latest frame.
+  Frames with status 0 carry no measurements and are ignored.
+*/
+void KilovaultBank::on_status_(Battery &battery, const StatusData &status_data) {
+  if (status_data.status == 0)
+    return;
+
+  if (battery.online)
+    this->add_(battery, -1);
+
+  battery.voltage = status_data.voltage;
+  battery.current = status_data.current;
+  battery.power = frame_power_mw(status_data);
+  battery.total_capacity = status_data.total_capacity;
+  battery.state_of_charge = status_data.state_of_charge;
+  battery.remaining = uint64_t(status_data.total_capacity) * status_data.state_of_charge;
+
+  CellVoltageRange range = frame_cell_voltage_range(status_data);
+  battery.min_cell_voltage = range.min;
+  battery.max_cell_voltage = range.max;
+
+  battery.online = true;
+  battery.last_seen = millis();
+  this->add_(battery, 1);
+}
+
+/* ========================================================================= */
+void KilovaultBank::add_(const Battery &battery, int sign) {
+  this->online_ += sign;
+  this->voltage_sum_ += sign * int64_t(battery.voltage);
+  this->current_sum_ += sign * int64_t(battery.current);
+  this->power_sum_ += sign * battery.power;
+  this->capacity_sum_ += sign * int64_t(battery.total_capacity);
+  this->remaining_sum_ += sign * int64_t(battery.remaining);
+}
+
+/* ========================================================================= */
+/*
+  Drops stale batteries and publishes the bank values. The cell voltage and state of
+  charge extremes are taken over the online batteries here, which is a handful of
+  compares per update instead of work on every frame.
+*/
+void KilovaultBank::update() {
+  uint32_t now = millis();
+  for (auto &battery : this->batteries_) {
+    if (battery.online && now - battery.last_seen > this->stale_timeout_) {
+      ESP_LOGW(TAG, "[%s] No frame for %" PRIu32 " ms, leaving it out of the bank",
+               battery.battery->parent()->address_str().c_str(), now - battery.last_seen);
+      this->add_(battery, -1);
+      battery.online = false;
+    }
+  }
+
+  this->publish_state_(this->online_batteries_sensor_, this->online_);
+
+  if (this->online_ == 0) {
+    this->publish_state_(this->voltage_sensor_, NAN);
+    this->publish_state_(this->current_sensor_, NAN);
+    this->publish_state_(this->power_sensor_, NAN);
+    this->publish_state_(this->state_of_charge_sensor_, NAN);
+    this->publish_state_(this->remaining_capacity_sensor_, NAN);
+    this->publish_state_(this->min_cell_voltage_sensor_, NAN);
+    this->publish_state_(this->max_cell_voltage_sensor_, NAN);
+    this->publish_state_(this->delta_cell_voltage_sensor_, NAN);
+    this->publish_state_(this->state_of_charge_spread_sensor_, NAN);
+    return;
+  }
+
+  uint16_t min_cell_voltage = UINT16_MAX;
+  uint16_t max_cell_voltage = 0;
+  uint16_t min_state_of_charge = UINT16_MAX;
+  uint16_t max_state_of_charge = 0;
+  for (auto &battery : this->batteries_) {
+    if (!battery.online)
+      continue;
+    min_cell_voltage = std::min(min_cell_voltage, battery.min_cell_voltage);
+    max_cell_voltage = std::max(max_cell_voltage, battery.max_cell_voltage);
+    min_state_of_charge = std::min(min_state_of_charge, battery.state_of_charge);
+    max_state_of_charge = std::max(max_state_of_charge, battery.state_of_charge);
+  }
+
+  // Parallel batteries share the bus voltage, the currents and powers add up
+  this->publish_state_(this->voltage_sensor_, this->voltage_sum_ * 0.001f / this->online_);
+  this->publish_state_(this->current_sensor_, this->current_sum_ * 0.001f);
+  this->publish_state_(this->power_sensor_, this->power_sum_ * 0.001f);
+
+  // Bank state of charge is weighted by the capacity of each battery
+  if (this->capacity_sum_ > 0)
+    this->publish_state_(this->state_of_charge_sensor_, (float) this->remaining_sum_ / this->capacity_sum_);
+  this->publish_state_(this->remaining_capacity_sensor_, this->remaining_sum_ * 0.00001f);
+
+  if (min_cell_voltage != UINT16_MAX) {
+    this->publish_state_(this->min_cell_voltage_sensor_, min_cell_voltage * 0.001f);
+    this->publish_state_(this->max_cell_voltage_sensor_, max_cell_voltage * 0.001f);
+    this->publish_state_(this->delta_cell_voltage_sensor_, (max_cell_voltage - min_cell_voltage) * 0.001f);
+  }
+  this->publish_state_(this->state_of_charge_spread_sensor_, max_state_of_charge - min_state_of_charge);
+}
+
+/* ========================================================================= */
+void KilovaultBank::dump_config() {
+  ESP_LOGCONFIG(TAG, "KilovaultBank:");
+  ESP_LOGCONFIG(TAG, "  Batteries: %u", (unsigned) this->batteries_.size());
+  ESP_LOGCONFIG(TAG, "  Stale timeout: %" PRIu32 " ms", this->stale_timeout_);
+  LOG_UPDATE_INTERVAL(this);
+
+  LOG_SENSOR("", "Voltage", this->voltage_sensor_);
+  LOG_SENSOR("", "Current", this->current_sensor_);
+  LOG_SENSOR("", "Power", this->power_sensor_);
+  LOG_SENSOR("", "State of charge", this->state_of_charge_sensor_);
+  LOG_SENSOR("", "Remaining capacity", this->remaining_capacity_sensor_);
+  LOG_SENSOR("", "Min cell voltage", this->min_cell_voltage_sensor_);
+  LOG_SENSOR("", "Max cell voltage", this->max_cell_voltage_sensor_);
+  LOG_SENSOR("", "Delta cell voltage", this->delta_cell_voltage_sensor_);
+  LOG_SENSOR("", "State of charge spread", this->state_of_charge_spread_sensor_);
+  LOG_SENSOR("", "Online batteries", this->online_batteries_sensor_);
+}
+
+/* ========================================================================= */
+void KilovaultBank::publish_state_(sensor::Sensor *sensor, float value) {
+  if (sensor == nullptr)
+    return;
+
+  sensor->publish_state(value);
+}
+
+}  // namespace kilovault_bank
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/kilovault_bms_ble/kilovault_bms_ble.h"
+
+#ifdef USE_ESP32
+
+#include <vector>
+
+namespace esphome {
+namespace kilovault_bank {
+
+using kilovault_bms_ble::CellVoltageRange;
+using kilovault_bms_ble::KilovaultBmsBle;
+using kilovault_bms_ble::StatusData;
+
+/*
+  Aggregates several KilovaultBmsBle batteries wired in parallel into one bank.
+
+  Every battery reports its frames through a status callback. The bank keeps running
+  sums over the online batteries and updates them in O(1) whenever a battery sends a
+  frame: the old contribution of that battery is taken out and the new one added.
+  Batteries that stay silent for longer than the stale timeout are dropped from the
+  sums until they report again. update() publishes the bank values at its own interval.
+*/
+class KilovaultBank : public PollingComponent {
+ public:
+  void setup() override;
+  void dump_config() override;
+  void update() override;
+  float get_setup_priority() const override { return setup_priority::DATA; }
+
+  void add_battery(KilovaultBmsBle *battery) { this->batteries_.push_back({battery}); }
+  void set_stale_timeout(uint32_t stale_timeout) { stale_timeout_ = stale_timeout; }
+
+  void set_voltage_sensor(sensor::Sensor *voltage_sensor) { voltage_sensor_ = voltage_sensor; }
+  void set_current_sensor(sensor::Sensor *current_sensor) { current_sensor_ = current_sensor; }
+  void set_power_sensor(sensor::Sensor *power_sensor) { power_sensor_ = power_sensor; }
+  void set_state_of_charge_sensor(sensor::Sensor *state_of_charge_sensor) {
+    state_of_charge_sensor_ = state_of_charge_sensor;
+  }
+  void set_remaining_capacity_sensor(sensor::Sensor *remaining_capacity_sensor) {
+    remaining_capacity_sensor_ = remaining_capacity_sensor;
+  }
+  void set_min_cell_voltage_sensor(sensor::Sensor *min_cell_voltage_sensor) {
+    min_cell_voltage_sensor_ = min_cell_voltage_sensor;
+  }
+  void set_max_cell_voltage_sensor(sensor::Sensor *max_cell_voltage_sensor) {
+    max_cell_voltage_sensor_ = max_cell_voltage_sensor;
+  }
+  void set_delta_cell_voltage_sensor(sensor::Sensor *delta_cell_voltage_sensor) {
+    delta_cell_voltage_sensor_ = delta_cell_voltage_sensor;
+  }
+  void set_state_of_charge_spread_sensor(sensor::Sensor *state_of_charge_spread_sensor) {
+    state_of_charge_spread_sensor_ = state_of_charge_spread_sensor;
+  }
+  void set_online_batteries_sensor(sensor::Sensor *online_batteries_sensor) {
+    online_batteries_sensor_ = online_batteries_sensor;
+  }
+
+ protected:
+  // Contribution of a single battery to the bank sums, in the units the BMS sends
+  struct Battery {
+    KilovaultBmsBle *battery;
+    bool online{false};
+    uint32_t last_seen{0};
+    uint16_t voltage{0};          // mV
+    int32_t current{0};           // mA
+    int64_t power{0};             // mW
+    uint32_t total_capacity{0};   // mAh
+    uint64_t remaining{0};        // mAh * %
+    uint16_t state_of_charge{0};  // %
+    uint16_t min_cell_voltage{0};  // mV
+    uint16_t max_cell_voltage{0};  // mV
+  };
+
+  void on_status_(Battery &battery, const StatusData &status_data);
+  void add_(const Battery &battery, int sign);
+
+  std::vector<Battery> batteries_;
+  uint32_t stale_timeout_{60000};
+
+  // Running sums over the online batteries
+  uint8_t online_{0};
+  int64_t voltage_sum_{0};
+  int64_t current_sum_{0};
+  int64_t power_sum_{0};
+  int64_t capacity_sum_{0};
+  int64_t remaining_sum_{0};
+
+  sensor::Sensor *voltage_sensor_{nullptr};
+  sensor::Sensor *current_sensor_{nullptr};
+  sensor::Sensor *power_sensor_{nullptr};
+  sensor::Sensor *state_of_charge_sensor_{nullptr};
+  sensor::Sensor *remaining_capacity_sensor_{nullptr};
+  sensor::Sensor *min_cell_voltage_sensor_{nullptr};
+  sensor::Sensor *max_cell_voltage_sensor_{nullptr};
+  sensor::Sensor *delta_cell_voltage_sensor_{nullptr};
+  sensor::Sensor *state_of_charge_spread_sensor_{nullptr};
+  sensor::Sensor *online_batteries_sensor_{nullptr};
+
+  void publish_state_(sensor::Sensor *sensor, float value);
+};
+
+}  // namespace kilovault_bank
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,140 @@
+import esphome.codegen as cg
+from esphome.components import sensor
+import esphome.config_validation as cv
+from esphome.const import (
+    CONF_CURRENT,
+    CONF_POWER,
+    DEVICE_CLASS_CURRENT,
+    DEVICE_CLASS_EMPTY,
+    DEVICE_CLASS_POWER,
+    DEVICE_CLASS_VOLTAGE,
+    ICON_EMPTY,
+    STATE_CLASS_MEASUREMENT,
+    UNIT_AMPERE,
+    UNIT_EMPTY,
+    UNIT_PERCENT,
+    UNIT_VOLT,
+    UNIT_WATT,
+)
+
+from . import CONF_KILOVAULT_BANK_ID, KilovaultBank
+
+DEPENDENCIES = ["kilovault_bank"]
+
+CODEOWNERS = ["@syssi"]
+
+CONF_VOLTAGE = "voltage"
+CONF_STATE_OF_CHARGE = "state_of_charge"
+CONF_REMAINING_CAPACITY = "remaining_capacity"
+CONF_MIN_CELL_VOLTAGE = "min_cell_voltage"
+CONF_MAX_CELL_VOLTAGE = "max_cell_voltage"
+CONF_DELTA_CELL_VOLTAGE = "delta_cell_voltage"
+CONF_STATE_OF_CHARGE_SPREAD = "state_of_charge_spread"
+CONF_ONLINE_BATTERIES = "online_batteries"
+
+ICON_CURRENT_DC = "mdi:current-dc"
+ICON_STATE_OF_CHARGE = "mdi:battery-50"
+ICON_MIN_CELL_VOLTAGE = "mdi:battery-minus-outline"
+ICON_MAX_CELL_VOLTAGE = "mdi:battery-plus-outline"
+ICON_ONLINE_BATTERIES = "mdi:battery-sync"
+
+UNIT_AMPERE_HOURS = "Ah"
+
+SENSORS = [
+    CONF_VOLTAGE,
+    CONF_CURRENT,
+    CONF_POWER,
+    CONF_STATE_OF_CHARGE,
+    CONF_REMAINING_CAPACITY,
+    CONF_MIN_CELL_VOLTAGE,
+    CONF_MAX_CELL_VOLTAGE,
+    CONF_DELTA_CELL_VOLTAGE,
+    CONF_STATE_OF_CHARGE_SPREAD,
+    CONF_ONLINE_BATTERIES,
+]
+
+# pylint: disable=too-many-function-args
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_KILOVAULT_BANK_ID): cv.use_id(KilovaultBank),
+        cv.Optional(CONF_VOLTAGE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_VOLT,
+            icon=ICON_EMPTY,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_VOLTAGE,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_CURRENT): sensor.sensor_schema(
+            unit_of_measurement=UNIT_AMPERE,
+            icon=ICON_CURRENT_DC,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_CURRENT,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_POWER): sensor.sensor_schema(
+            unit_of_measurement=UNIT_WATT,
+            icon=ICON_EMPTY,
+            accuracy_decimals=2,
+            device_class=DEVICE_CLASS_POWER,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_STATE_OF_CHARGE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            icon=ICON_STATE_OF_CHARGE,
+            accuracy_decimals=1,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_REMAINING_CAPACITY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_AMPERE_HOURS,
+            icon=ICON_STATE_OF_CHARGE,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_MIN_CELL_VOLTAGE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_VOLT,
+            icon=ICON_MIN_CELL_VOLTAGE,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_VOLTAGE,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_MAX_CELL_VOLTAGE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_VOLT,
+            icon=ICON_MAX_CELL_VOLTAGE,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_VOLTAGE,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_DELTA_CELL_VOLTAGE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_VOLT,
+            icon=ICON_EMPTY,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_VOLTAGE,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_STATE_OF_CHARGE_SPREAD): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            icon=ICON_STATE_OF_CHARGE,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_ONLINE_BATTERIES): sensor.sensor_schema(
+            unit_of_measurement=UNIT_EMPTY,
+            icon=ICON_ONLINE_BATTERIES,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+    }
+)
+
+
+async def to_code(config):
+    hub = await cg.get_variable(config[CONF_KILOVAULT_BANK_ID])
+    for key in SENSORS:
+        if key in config:
+            conf = config[key]
+            sens = await sensor.new_sensor(conf)
+            cg.add(getattr(hub, f"set_{key}_sensor")(sens))
@@ -1,7 +1,9 @@
+from esphome import automation
 import esphome.codegen as cg
 from esphome.components import ble_client
 import esphome.config_validation as cv
-from esphome.const import CONF_ID
+import esphome.final_validate as fv
+from esphome.const import CONF_ID, CONF_TRIGGER_ID
 
 # CONFIG_VALIDATION: Uses an underlying system  called voluptuous here:
 #   https://github.com/alecthomas/voluptuous
@@ -18,26 +20,161 @@ AUTO_LOAD = ["binary_sensor", "sensor", "switch", "text_sensor"]
 MULTI_CONF = True
 
 CONF_KILOVAULT_BMS_BLE_ID = "kilovault_bms_ble_id"
+CONF_ENERGY_SAVE_INTERVAL = "energy_save_interval"
+CONF_ENERGY_SAVE_DELTA = "energy_save_delta"
+CONF_GATT_CACHE = "gatt_cache"
+CONF_MTU = "mtu"
+CONF_RECONNECT_DELAY = "reconnect_delay"
+CONF_RECONNECT_MAX_DELAY = "reconnect_max_delay"
+CONF_CAPTURE_SIZE = "capture_size"
+CONF_COMMAND_TIMEOUT = "command_timeout"
+CONF_COMMAND_RETRIES = "command_retries"
+CONF_CELL_COUNT = "cell_count"
+CONF_RESISTANCE_CURRENT_STEP = "resistance_current_step"
+CONF_DEVIATION_TIME_CONSTANT = "deviation_time_constant"
+CONF_DECODE_TASK = "decode_task"
+CONF_DECODE_QUEUE_SIZE = "decode_queue_size"
+CONF_LIMITS = "limits"
+CONF_MAX_CHARGE_CURRENT = "max_charge_current"
+CONF_MAX_DISCHARGE_CURRENT = "max_discharge_current"
+CONF_MIN_CELL_VOLTAGE = "min_cell_voltage"
+CONF_MAX_CELL_VOLTAGE = "max_cell_voltage"
+CONF_MIN_TEMPERATURE = "min_temperature"
+CONF_MAX_TEMPERATURE = "max_temperature"
+CONF_ON_ALARM = "on_alarm"
+
+# 12 V, 24 V and 48 V packs. All cells fit in the status frame in front of the checksum.
+CELL_COUNTS = [4, 8, 16]
+MAX_CELLS = max(CELL_COUNTS)
 
 kilovault_bms_ble_ns = cg.esphome_ns.namespace("kilovault_bms_ble")
 
 KilovaultBmsBle = kilovault_bms_ble_ns.class_(
     "KilovaultBmsBle", ble_client.BLEClientNode, cg.PollingComponent
 )
+AlarmTrigger = kilovault_bms_ble_ns.class_(
+    "AlarmTrigger", automation.Trigger.template(cg.std_string, cg.float_)
+)
+
+# Hard limits, checked on every frame. Each key has a set_<key>_limit setter.
+LIMITS = {
+    CONF_MAX_CHARGE_CURRENT: cv.current,
+    CONF_MAX_DISCHARGE_CURRENT: cv.current,
+    CONF_MIN_CELL_VOLTAGE: cv.voltage,
+    CONF_MAX_CELL_VOLTAGE: cv.voltage,
+    CONF_MIN_TEMPERATURE: cv.temperature,
+    CONF_MAX_TEMPERATURE: cv.temperature,
+}
 
 CONFIG_SCHEMA = (
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(KilovaultBmsBle),
+            # Compiled in as KILOVAULT_CELL_COUNT, sizes the cell storage and loops
+            cv.Optional(CONF_CELL_COUNT, default=4): cv.one_of(*CELL_COUNTS, int=True),
+            # Flash wear control for the charge/energy totals: save at most once per
+            # interval, unless the energy moved by more than the delta (Wh).
+            cv.Optional(
+                CONF_ENERGY_SAVE_INTERVAL, default="15min"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_ENERGY_SAVE_DELTA, default=10.0): cv.positive_float,
+            # Save the GATT handles per MAC and subscribe with them right after connecting,
+            # without waiting for service discovery.
+            cv.Optional(CONF_GATT_CACHE, default=True): cv.boolean,
+            # ATT MTU to offer when connecting. From 124 up a whole frame fits in one
+            # notification. The node has one local MTU for all connections, with
+            # several batteries the largest value is used.
+            cv.Optional(CONF_MTU, default=247): cv.int_range(min=23, max=517),
+            # Backoff between reconnects, doubled after every connection without a frame.
+            cv.Optional(
+                CONF_RECONNECT_DELAY, default="1s"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_RECONNECT_MAX_DELAY, default="2min"
+            ): cv.positive_time_period_milliseconds,
+            # Bytes of RAM for the raw notification capture, 0 disables it. Dump it with
+            # the dump_capture button.
+            cv.Optional(CONF_CAPTURE_SIZE, default=0): cv.int_range(min=0, max=65535),
+            # Register writes (switches) wait this long for the BMS to acknowledge them,
+            # and are retried this many times before the switch rolls back.
+            cv.Optional(
+                CONF_COMMAND_TIMEOUT, default="2s"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_COMMAND_RETRIES, default=2): cv.int_range(min=0, max=10),
+            # Cell trends: the current change (A) between two frames that counts as a
+            # resistance sample, and the time constant of the cell deviation average.
+            cv.Optional(CONF_RESISTANCE_CURRENT_STEP, default=2.0): cv.positive_float,
+            cv.Optional(
+                CONF_DEVIATION_TIME_CONSTANT, default="1h"
+            ): cv.positive_time_period_milliseconds,
+            # Frame and decode on a task on the other core, the BLE callback only queues
+            # the raw notifications into a ring of this many bytes. A power of two, so
+            # the ring can map its free running counters to a position with a mask.
+            cv.Optional(CONF_DECODE_TASK, default=False): cv.boolean,
+            cv.Optional(CONF_DECODE_QUEUE_SIZE, default=2048): cv.one_of(
+                1024, 2048, 4096, 8192, 16384, 32768, int=True
+            ),
+            # Breaking a limit publishes the sensor right away, past its publish filter,
+            # and fires on_alarm with the name of the alarm and the value.
+            cv.Optional(CONF_LIMITS): cv.Schema(
+                {cv.Optional(key): validator for key, validator in LIMITS.items()}
+            ),
+            cv.Optional(CONF_ON_ALARM): automation.validate_automation(
+                {
+                    cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(AlarmTrigger),
+                }
+            ),
         }
     )
     .extend(ble_client.BLE_CLIENT_SCHEMA)
     .extend(cv.polling_component_schema("10s"))
 )
 
+# The cell count is a compile time constant, so every battery on a node shares it
+def _final_validate(config):
+    cell_counts = {
+        conf[CONF_CELL_COUNT] for conf in fv.full_config.get()["kilovault_bms_ble"]
+    }
+    if len(cell_counts) > 1:
+        raise cv.Invalid(
+            f"All kilovault_bms_ble batteries on a node need the same {CONF_CELL_COUNT}, got {sorted(cell_counts)}"
+        )
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
+
 # Code Generation
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
     await ble_client.register_ble_node(var, config)
 
+    cg.add_define("KILOVAULT_CELL_COUNT", config[CONF_CELL_COUNT])
+
+    cg.add(var.set_energy_save_interval(config[CONF_ENERGY_SAVE_INTERVAL]))
+    cg.add(var.set_energy_save_delta(config[CONF_ENERGY_SAVE_DELTA]))
+    cg.add(var.set_gatt_cache(config[CONF_GATT_CACHE]))
+    cg.add(var.set_mtu(config[CONF_MTU]))
+    cg.add(var.set_reconnect_delay(config[CONF_RECONNECT_DELAY]))
+    cg.add(var.set_reconnect_max_delay(config[CONF_RECONNECT_MAX_DELAY]))
+    cg.add(var.set_capture_size(config[CONF_CAPTURE_SIZE]))
+    cg.add(var.set_command_timeout(config[CONF_COMMAND_TIMEOUT]))
+    cg.add(var.set_command_retries(config[CONF_COMMAND_RETRIES]))
+    cg.add(var.set_resistance_current_step(config[CONF_RESISTANCE_CURRENT_STEP]))
+    cg.add(var.set_deviation_time_constant(config[CONF_DEVIATION_TIME_CONSTANT]))
+    if config[CONF_DECODE_TASK]:
+        cg.add_define("USE_KILOVAULT_DECODE_TASK")
+        cg.add(var.set_decode_task(True))
+        cg.add(var.set_decode_queue_size(config[CONF_DECODE_QUEUE_SIZE]))
+    if CONF_LIMITS in config:
+        cg.add_define("USE_KILOVAULT_ALARMS")
+        for key, value in config[CONF_LIMITS].items():
+            cg.add(getattr(var, f"set_{key}_limit")(value))
+    for conf in config.get(CONF_ON_ALARM, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(
+            trigger, [(cg.std_string, "alarm"), (cg.float_, "value")], conf
+        )
+
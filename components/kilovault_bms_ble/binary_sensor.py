@@ -11,16 +11,40 @@ CODEOWNERS = ["@syssi"]
 
 CONF_CHARGING = "charging"
 CONF_DISCHARGING = "discharging"
+CONF_ALARM = "alarm"
 
 ICON_CHARGING = "mdi:battery-charging"
 ICON_DISCHARGING = "mdi:power-plug"
+ICON_ALARM = "mdi:battery-alert"
+ICON_STATUS_BIT = "mdi:alert-circle-outline"
 
+# One binary sensor per bit of the status and AFE status words, published on edges
+STATUS_BITS = [f"status_bit_{i}" for i in range(16)]
+AFE_STATUS_BITS = [f"afe_status_bit_{i}" for i in range(16)]
+
+# On while any of the limits of the hub is broken
 BINARY_SENSORS = [
+    CONF_ALARM,
 ]
 
+
+def binary_sensor_schema(icon):
+    return binary_sensor.BINARY_SENSOR_SCHEMA.extend(
+        {
+            cv.GenerateID(): cv.declare_id(binary_sensor.BinarySensor),
+            cv.Optional(CONF_ICON, default=icon): cv.icon,
+        }
+    )
+
+
 CONFIG_SCHEMA = cv.Schema(
     {
         cv.GenerateID(CONF_KILOVAULT_BMS_BLE_ID): cv.use_id(KilovaultBmsBle),
+        cv.Optional(CONF_ALARM): binary_sensor_schema(ICON_ALARM),
+        **{
+            cv.Optional(key): binary_sensor_schema(ICON_STATUS_BIT)
+            for key in STATUS_BITS + AFE_STATUS_BITS
+        },
     }
 )
 
@@ -33,3 +57,11 @@ async def to_code(config):
             sens = cg.new_Pvariable(conf[CONF_ID])
             await binary_sensor.register_binary_sensor(sens, conf)
             cg.add(getattr(hub, f"set_{key}_binary_sensor")(sens))
+    for prefix, keys in (("status_bit", STATUS_BITS), ("afe_status_bit", AFE_STATUS_BITS)):
+        for bit, key in enumerate(keys):
+            if key in config:
+                conf = config[key]
+                sens = cg.new_Pvariable(conf[CONF_ID])
+                await binary_sensor.register_binary_sensor(sens, conf)
+                cg.add(getattr(hub, f"set_{prefix}_binary_sensor")(bit, sens))
+                cg.add_define("USE_KILOVAULT_STATUS_BITS")
@@ -0,0 +1,53 @@
+import esphome.codegen as cg
+from esphome.components import button
+import esphome.config_validation as cv
+from esphome.const import (
+    CONF_ENTITY_CATEGORY,
+    CONF_ICON,
+    CONF_ID,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+from .. import CONF_KILOVAULT_BMS_BLE_ID, KilovaultBmsBle, kilovault_bms_ble_ns
+
+DEPENDENCIES = ["kilovault_bms_ble"]
+
+CODEOWNERS = ["@syssi"]
+
+CONF_DUMP_CAPTURE = "dump_capture"
+
+ICON_DUMP_CAPTURE = "mdi:file-download-outline"
+
+KilovaultButton = kilovault_bms_ble_ns.class_("KilovaultButton", button.Button, cg.Component)
+KilovaultButtonAction = kilovault_bms_ble_ns.enum("KilovaultButtonAction", is_class=True)
+
+BUTTONS = {
+    CONF_DUMP_CAPTURE: KilovaultButtonAction.DUMP_CAPTURE,
+}
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_KILOVAULT_BMS_BLE_ID): cv.use_id(KilovaultBmsBle),
+        cv.Optional(CONF_DUMP_CAPTURE): button.BUTTON_SCHEMA.extend(
+            {
+                cv.GenerateID(): cv.declare_id(KilovaultButton),
+                cv.Optional(CONF_ICON, default=ICON_DUMP_CAPTURE): cv.icon,
+                cv.Optional(
+                    CONF_ENTITY_CATEGORY, default=ENTITY_CATEGORY_DIAGNOSTIC
+                ): cv.entity_category,
+            }
+        ).extend(cv.COMPONENT_SCHEMA),
+    }
+)
+
+
+async def to_code(config):
+    hub = await cg.get_variable(config[CONF_KILOVAULT_BMS_BLE_ID])
+    for key, action in BUTTONS.items():
+        if key in config:
+            conf = config[key]
+            var = cg.new_Pvariable(conf[CONF_ID])
+            await cg.register_component(var, conf)
+            await button.register_button(var, conf)
+            cg.add(var.set_parent(hub))
+            cg.add(var.set_action(action))
@@ -0,0 +1,19 @@
+#include "kilovault_button.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+
+static const char *const TAG = "kilovault_bms_ble.button";
+
+void KilovaultButton::dump_config() { LOG_BUTTON("", "KilovaultBmsBle Button", this); }
+void KilovaultButton::press_action() {
+  switch (this->action_) {
+    case KilovaultButtonAction::DUMP_CAPTURE:
+      this->parent_->dump_capture();
+      break;
+  }
+}
+
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
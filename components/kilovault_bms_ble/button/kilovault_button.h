@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../kilovault_bms_ble.h"
+#include "esphome/core/component.h"
+#include "esphome/components/button/button.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+
+enum class KilovaultButtonAction : uint8_t {
+  DUMP_CAPTURE,
+};
+
+class KilovaultBmsBle;
+class KilovaultButton : public button::Button, public Component {
+ public:
+  void set_parent(KilovaultBmsBle *parent) { this->parent_ = parent; };
+  void set_action(KilovaultButtonAction action) { this->action_ = action; };
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::DATA; }
+
+ protected:
+  void press_action() override;
+  KilovaultBmsBle *parent_;
+  KilovaultButtonAction action_;
+};
+
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
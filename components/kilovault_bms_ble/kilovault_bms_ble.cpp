@@ -1,24 +1,44 @@
 #include "kilovault_bms_ble.h"
 #include "esphome/core/log.h"
 #include "esphome/core/helpers.h"
+#include "esphome/core/hal.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
 
 
 /* MAP
   1.0 KilovaultBmsBle::gattc_event_handler()
     - Main Entry Point
+    - With decode_task, notifications are only queued here and 2.0 runs in
+      decode_task_() on the other core. loop() picks the frames up for 2.3.2.
+    1.1 subscribe_cached_() on open, subscribe_discovered_() once discovery completed
+    1.2 schedule_reconnect_() on disconnect, jittered exponential backoff
   2.0 KilovaultBmsBle::assemble_()
-    2.1 crc()
-    2.2 KilovaultBMSBle::ascii_to_int_() should this stay as lambda??
-    2.3 Hand off to on_kilovault_bms_ble_data_()
+    2.0.1 CaptureBuffer::record() (kilovault_capture.h), raw notifications for dump_capture()
+    2.1 Streaming framer, scans for the preamble and resyncs on truncated frames
+    2.2 FrameDecoder::advance() (kilovault_frame.h), converts, sums and decodes every chunk
+    2.3 KilovaultBmsBle::complete_frame_()
+      2.3.1 Checksum compare
+      2.3.2 Hand off to on_kilovault_bms_ble_data_(), stores the latest snapshot
+        2.3.2.1 update_windows_(), feeds every frame into the windowed statistics
+        2.3.2.2 EnergyIntegrator::add(), coulomb counting and energy totals
+        2.3.2.3 update_cell_trends_(), cell resistance and deviation estimates
+        2.3.2.4 publish_status_bits_() and check_alarms_(), published right away on edges
+        2.3.2.5 status callbacks, e.g. kilovault_bank
+  2.4 write_register(), queues commands for send_next_command_(), one write in flight
+    2.4.1 ESP_GATTC_WRITE_CHAR_EVT acknowledges it, retry_command_() on errors and timeouts
   3.0 KilovaultBmsBle::Update()
-    3.1 Hand off to decode_status_data_()
+    3.1 Hand off the latest snapshot to decode_status_data_()
+    3.2 publish_windows_(), publishes and restarts the windowed statistics
+    3.3 publish_energy_(), publishes the totals and saves them to flash when due
+    3.4 publish_diagnostics_(), rates, counters and decode time percentiles
+    3.5 publish_cell_trends_(), cell resistance and deviation estimates
   4.0 decode_status_data_()
-    4.1 kilovault_get_16bit() lambda
-    4.2 kilovault_get_32bit() lambda
-    4.3 Publishes Data
-    4.4 decode_cell_voltages_data_()
-      4.4.1 decode_cell_voltages_data_()
-      4.4.2 Publishes Data
+    4.1 Publishes Data
+    4.2 decode_cell_voltages_data_()
+      4.2.1 Publishes Data
 */
 
 namespace esphome {
@@ -26,56 +46,95 @@ namespace kilovault_bms_ble {
 
 static const char *const TAG = "kilovault_bms_ble";
 
+uint16_t KilovaultBmsBle::local_mtu_ = ESP_GATT_DEF_BLE_MTU_SIZE;
+
+namespace layout = layout_v1;
+
 //static const uint16_t KILOVAULT_BMS_SERVICE_UUID = 0xFA00;
 static const uint16_t KILOVAULT_BMS_SERVICE_UUID = 0xFFE0;
 static const uint16_t KILOVAULT_BMS_NOTIFY_CHARACTERISTIC_UUID = 0xFFE4;   // handle 0x12
 
 static const uint16_t KILOVAULT_BMS_CONTROL_CHARACTERISTIC_UUID = 0xFA02;  // handle 0x15
 
-static const uint16_t MAX_RESPONSE_SIZE = 121;
-
-static const uint8_t KILOVAULT_PKT_START_A = 0xB0;
-static const uint8_t KILOVAULT_PKT_START_B = 0xB0;
 static const uint8_t KILOVAULT_ADDRESS = 0x16;
 static const uint8_t KILOVAULT_PKT_END_1 = 0x52;
 static const uint8_t KILOVAULT_PKT_END_2 = 0x52;
 
+// Register writes waiting for the BMS, including the one in flight
+static const size_t COMMAND_QUEUE_SIZE = 8;
+
+// Cell resistance estimation: frames further apart are not paired, samples fade by the
+// forgetting factor, and the estimate is published once it has this many samples.
+static const uint32_t RESISTANCE_MAX_GAP = 10000;
+static const float RESISTANCE_FORGETTING = 0.99f;
+static const uint32_t RESISTANCE_MIN_SAMPLES = 5;
+
+// Frames further apart are not integrated into the energy totals, unless the update
+// interval is longer than half of this
+static const uint32_t ENERGY_MAX_GAP = 60000;
+
+// ATT header in front of every notification, a frame fits in one from MTU 124 up
+static const uint16_t ATT_NOTIFY_OVERHEAD = 3;
+
+// Names of the alarms as passed to on_alarm, in the order of the Alarm enum
+static const char *const ALARM_NAMES[ALARM_COUNT] = {
+    "charge_current",  "discharge_current", "cell_undervoltage",
+    "cell_overvoltage", "under_temperature", "over_temperature",
+};
+
+#ifdef USE_KILOVAULT_DECODE_TASK
+// The BLE controller and host run on PRO_CPU, the decode task gets the other core
+#if CONFIG_FREERTOS_UNICORE
+static const BaseType_t DECODE_TASK_CORE = 0;
+#else
+static const BaseType_t DECODE_TASK_CORE = 1;
+#endif
+static const uint32_t DECODE_TASK_STACK_SIZE = 4096;
+static const UBaseType_t DECODE_TASK_PRIORITY = 5;
+#endif
 
+/*
+  Feature flags. sensor.py and text_sensor.py add a USE_KILOVAULT_* define for every
+  configured entity, and the code that decodes and publishes it is only compiled in
+  when its flag is set. The power is derived from the raw voltage and current, so it is
+  computed as soon as one of the power sensors is in use.
 
-/* ========================================================================= */
-/* bool crc(const std::vector<uint8_t> &data)
-    This function is used to check the CRC of the data. 
-    The data is passed as a vector of uint8_t. 
-    The function returns a boolean value. 
-    If the CRC check fails, the function returns false. 
-
-    It is called inside the assemble_() function and that is the only place.
-
+  The defines are global, with several batteries on a node the code is in as soon as
+  one of them uses the entity. The nullptr check in publish_state_() covers the rest.
 */
-bool crc(const std::vector<uint8_t> &data) {
-  auto kilovault_get_8bit = [&](size_t i) -> uint8_t {
-    return ((uint8_t(data[i + 0]) << 4) | (uint8_t(data[i + 1]) << 0));
-  };
-  const uint16_t frame_size = 110; 
-  uint16_t crc = 0;
-
-  //ESP_LOGW(TAG, "CRC data: %s", format_hex_pretty(data).c_str());
+#if defined(USE_KILOVAULT_POWER) || defined(USE_KILOVAULT_CHARGING_POWER) || \
+    defined(USE_KILOVAULT_DISCHARGING_POWER)
+#define KILOVAULT_DECODE_POWER
+#endif
 
-  uint16_t remote_crc = (kilovault_get_8bit(frame_size-1) << 8) + kilovault_get_8bit(frame_size+1);
-  //ESP_LOGW(TAG, "Remote CRC  0x%04X", remote_crc);
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERY_VERBOSE
+// Bytes of a notification shown in the very verbose log
+static const size_t NOTIFY_LOG_SIZE = 64;
 
-  for (uint16_t i = 1; i < frame_size - 2; i+=2) {
-    crc = crc + kilovault_get_8bit(i);
-    //ESP_LOGW(TAG, "CRC  0x%04X", crc);
+/*
+  Hex dump into a caller provided buffer. format_hex_pretty() builds a std::string for
+  every notification, this keeps the very verbose log off the heap. Data longer than
+  NOTIFY_LOG_SIZE is cut off and marked with "..".
+*/
+static const char *format_notification(char (&buffer)[NOTIFY_LOG_SIZE * 3 + 3], const uint8_t *data, size_t length) {
+  static const char *const HEX = "0123456789ABCDEF";
+  char *out = buffer;
+  for (size_t i = 0; i < std::min(length, NOTIFY_LOG_SIZE); i++) {
+    if (i > 0)
+      *out++ = '.';
+    *out++ = HEX[data[i] >> 4];
+    *out++ = HEX[data[i] & 0x0F];
   }
-  //ESP_LOGW(TAG, "CRC  0x%04X", crc);
-
-  if (crc != remote_crc) {
-    ESP_LOGW(TAG, "CRC check failed! 0x%02X != 0x%02X", crc, remote_crc);
-    return false;
+  if (length > NOTIFY_LOG_SIZE) {
+    *out++ = '.';
+    *out++ = '.';
   }
-  return true;
+  *out = '\0';
+  return buffer;
 }
+#endif
+
+
 
 /* GATT:  Generic Attributes. Is the name of the interface used to connect to BTLE devices. 
 
@@ -97,58 +156,172 @@ void KilovaultBmsBle::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_i
                                       esp_ble_gattc_cb_param_t *param) {
   switch (event) {
 
+    case ESP_GATTC_REG_EVT: {  // ESP_GATTC_REG_EVT:  Event when ble_client registered, before any connection.
+      if (param->reg.status == ESP_GATT_OK)
+        this->raise_local_mtu_();
+      break;
+    }
+
     case ESP_GATTC_OPEN_EVT: {  // ESP_GATTC_OPEN_EVT:  Event when a connection to a BLE device is opened.
+      if (param->open.status != ESP_GATT_OK) {
+        this->schedule_reconnect_();
+        break;
+      }
+
+      this->connected_at_ = millis();
+      this->awaiting_first_frame_ = true;
+      this->battery_mac_published_ = false;
+      // ble_client starts the MTU exchange itself, the answer comes in ESP_GATTC_CFG_MTU_EVT
+      this->negotiated_mtu_ = ESP_GATT_DEF_BLE_MTU_SIZE;
+
+      // Known battery: subscribe with the cached handles while ble_client is still
+      // discovering services, instead of waiting for ESP_GATTC_SEARCH_CMPL_EVT.
+      if (this->gatt_cache_valid_)
+        this->subscribe_cached_();
       break;
     }
 
     case ESP_GATTC_DISCONNECT_EVT: {  // ESP_GATTC_DISCONNECT_EVT:  Event when a BLE device is disconnected.
       this->node_state = espbt::ClientState::IDLE;
+      this->gatt_cache_subscribed_ = false;
+#ifdef USE_KILOVAULT_DECODE_TASK
+      if (this->decode_task_handle_ != nullptr) {
+        // The framer belongs to the decode task, queue the reset behind the last chunk
+        this->decode_queue_.push_gap();
+        xTaskNotifyGive(this->decode_task_handle_);
+      } else {
+        this->reset_framer_();
+      }
+#else
+      this->reset_framer_();
+#endif
+
+      // The write in flight is lost with the link, it is sent again after reconnecting
+      if (this->command_in_flight_) {
+        this->cancel_timeout("command");
+        this->command_in_flight_ = false;
+      }
+      this->schedule_reconnect_();
+
+      // The current while the link was down is unknown, do not bridge it. A scheduled
+      // battery is disconnected between its slots on purpose, its max gap covers that.
+      if (!this->scheduled_)
+        this->energy_.restart();
 
       // this->publish_state_(this->voltage_sensor_, NAN);
       break;
     }
 
+    case ESP_GATTC_CFG_MTU_EVT: {  // ESP_GATTC_CFG_MTU_EVT:  Event when the MTU exchange completed.
+      // A refused exchange is not fatal, the framer reassembles default sized chunks
+      if (param->cfg_mtu.status != ESP_GATT_OK) {
+        ESP_LOGW(TAG, "[%s] MTU exchange failed, status=%d, staying at %u", this->parent_->address_str().c_str(),
+                 param->cfg_mtu.status, ESP_GATT_DEF_BLE_MTU_SIZE);
+        this->negotiated_mtu_ = ESP_GATT_DEF_BLE_MTU_SIZE;
+        break;
+      }
+
+      this->negotiated_mtu_ = param->cfg_mtu.mtu;
+      ESP_LOGD(TAG, "[%s] MTU %u, %s", this->parent_->address_str().c_str(), this->negotiated_mtu_,
+               this->negotiated_mtu_ >= MAX_RESPONSE_SIZE + ATT_NOTIFY_OVERHEAD ? "a frame fits in one notification"
+                                                                                : "frames arrive in chunks");
+      break;
+    }
+
     case ESP_GATTC_SEARCH_CMPL_EVT: { // ESP_GATTC_SEARCH_CMPL_EVT:  Event when the search for services is completed.
+      this->subscribe_discovered_();
+      break;
+    }
 
-      auto *char_notify =
-          this->parent_->get_characteristic(KILOVAULT_BMS_SERVICE_UUID, KILOVAULT_BMS_NOTIFY_CHARACTERISTIC_UUID);
-      if (char_notify == nullptr) {
-        ESP_LOGE(TAG, "[%s] No notify service found at device, not an KILOVAULT BMS..?",
-                 this->parent_->address_str().c_str());
+    case ESP_GATTC_REG_FOR_NOTIFY_EVT: {  // ESP_GATTC_REG_FOR_NOTIFY_EVT:  Event when a notification is registered.
+      if (param->reg_for_notify.status != ESP_GATT_OK) {
+        ESP_LOGW(TAG, "[%s] Registering for notifications on handle 0x%02X failed, status=%d",
+                 this->parent_->address_str().c_str(), param->reg_for_notify.handle, param->reg_for_notify.status);
+        if (this->gatt_cache_subscribed_) {
+          // Stale cache, forget it and let the discovered handles take over.
+          this->gatt_cache_valid_ = false;
+          this->gatt_cache_subscribed_ = false;
+        }
         break;
       }
-      this->char_notify_handle_ = char_notify->handle;
 
-      auto status = esp_ble_gattc_register_for_notify(this->parent()->get_gattc_if(), this->parent()->get_remote_bda(),
-                                                      char_notify->handle);
-      if (status) {
-        ESP_LOGW(TAG, "esp_ble_gattc_register_for_notify failed, status=%d", status);
+      // ble_client enables the notifications itself once the services are known. On the
+      // cached path they are not known yet, so write the configuration descriptor here.
+      if (this->gatt_cache_subscribed_ && this->node_state != espbt::ClientState::ESTABLISHED) {
+        uint8_t notify_enable[2] = {0x01, 0x00};
+        auto status = esp_ble_gattc_write_char_descr(this->parent_->get_gattc_if(), this->parent_->get_conn_id(),
+                                                     this->gatt_cache_.cccd_handle, sizeof(notify_enable),
+                                                     notify_enable, ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
+        if (status) {
+          ESP_LOGW(TAG, "esp_ble_gattc_write_char_descr failed, status=%d", status);
+        }
       }
+      this->node_state = espbt::ClientState::ESTABLISHED;
+      this->send_next_command_();
 
-      auto *char_command =
-          this->parent_->get_characteristic(KILOVAULT_BMS_SERVICE_UUID, KILOVAULT_BMS_CONTROL_CHARACTERISTIC_UUID);
-      if (char_command == nullptr) {
-        ESP_LOGE(TAG, "[%s] No control service found at device, not an KILOVAULT BMS..?",
-                 this->parent_->address_str().c_str());
-        break;
-      }
-      this->char_command_handle_ = char_command->handle;
       break;
     }
 
-    case ESP_GATTC_REG_FOR_NOTIFY_EVT: {  // ESP_GATTC_REG_FOR_NOTIFY_EVT:  Event when a notification is registered.
-      this->node_state = espbt::ClientState::ESTABLISHED;
+    case ESP_GATTC_WRITE_CHAR_EVT: {  // ESP_GATTC_WRITE_CHAR_EVT:  Event when a write was acknowledged.
+      if (!this->command_in_flight_ || param->write.handle != this->char_command_handle_)
+        break;
 
+      if (param->write.status == ESP_GATT_OK) {
+        this->finish_command_(true);
+      } else {
+        ESP_LOGW(TAG, "[%s] Write to register 0x%02X failed, status=%d", this->parent_->address_str().c_str(),
+                 this->command_queue_.front().address, param->write.status);
+        this->retry_command_();
+      }
       break;
     }
 
     // This is the main entry point for data from the BMS
     case ESP_GATTC_NOTIFY_EVT: { // ESP_GATTC_NOTIFY_EVT:  Event when a notification is received.
-      ESP_LOGVV(TAG, "Notification received (handle 0x%02X): %s", param->notify.handle,
-                format_hex_pretty(param->notify.value, param->notify.value_len).c_str());
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERY_VERBOSE
+      if (param->notify.value != nullptr) {
+        char hex[NOTIFY_LOG_SIZE * 3 + 3];
+        ESP_LOGVV(TAG, "Notification received (handle 0x%02X, %u bytes): %s", param->notify.handle,
+                  param->notify.value_len, format_notification(hex, param->notify.value, param->notify.value_len));
+      }
+#endif
+
+      // Nothing below trusts the radio: empty notifications, other characteristics and
+      // values longer than any valid attribute are dropped before they are touched.
+      if (param->notify.value == nullptr || param->notify.value_len == 0)
+        break;
+      if (this->char_notify_handle_ != 0 && param->notify.handle != this->char_notify_handle_) {
+        ESP_LOGV(TAG, "Ignoring notification from handle 0x%02X", param->notify.handle);
+        break;
+      }
+      if (param->notify.value_len > MAX_NOTIFY_SIZE) {
+        ESP_LOGW(TAG, "Dropping oversized notification of %u bytes", param->notify.value_len);
+        this->oversize_count_++;
+        this->oversize_bytes_ += param->notify.value_len;
+        break;
+      }
+      this->notification_count_++;
+
+      if (this->capture_.enabled())
+        this->capture_.record(millis(), param->notify.value, param->notify.value_len);
+
+#ifdef USE_KILOVAULT_DECODE_TASK
+      // Hand the chunk to decode_task_(), this never blocks. A full queue drops it.
+      if (this->decode_task_handle_ != nullptr) {
+        if (this->decode_queue_.push(param->notify.value, param->notify.value_len))
+          xTaskNotifyGive(this->decode_task_handle_);
+        break;
+      }
+#endif
 
       // assemble_() is defined below
+#ifdef USE_KILOVAULT_DECODE_TIME
+      uint32_t started = micros();
       this->assemble_(param->notify.value, param->notify.value_len);
+      this->decode_time_.add(micros() - started);
+#else
+      this->assemble_(param->notify.value, param->notify.value_len);
+#endif
       break;
     }
 
@@ -157,257 +330,982 @@ void KilovaultBmsBle::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_i
   }
 }
 
-// KC: Moved ascii_to_int to a seperate function
-uint8_t KilovaultBmsBle::ascii_to_int_(const uint8_t c) {
-    uint8_t v = c;
-    if ((c >= 48) && (c <= 57))
-        v = (c - 48);
-    else if ((c >= 65) && (c <= 70))
-        v = (c - 65 + 10);
-    else if ((c >= 97) && (c <= 102))
-        v = (c - 97 + 10);   
-    return v;
+/* ========================================================================= */
+/* void KilovaultBmsBle::assemble_(const uint8_t *data, uint16_t length)
+    Streaming framer. Notifications are MTU sized chunks of the 121 byte ASCII frame, but
+    chunks get dropped or merged on a noisy link, so nothing here assumes a chunk starts
+    on a frame boundary. Once the MTU exchange gave an MTU that fits a frame, a whole frame
+    usually arrives in one notification and is decoded straight from it, without being
+    copied into frame_buffer_.
+
+    The framer has two states:
+      - SEEK_PREAMBLE: scan the chunk for the preamble. Everything in front of it is dropped.
+      - IN_FRAME: copy bytes into frame_buffer_ until the frame is complete. The preamble is
+        never a valid ASCII-hex character, so seeing one here means the current frame lost
+        bytes. The partial frame is dropped and the new preamble starts the next frame.
+
+    A single chunk can finish one frame and start the next, every complete frame is handed
+    to complete_frame_() as soon as its last byte lands.
+
+    The conversion, checksum and field extraction run incrementally: after every chunk
+    decoder_ decodes whatever part of the frame is now complete, so the work is spread
+    evenly over the notifications instead of piling up on the last one.
+
+    The work per call is linear in length, every byte is scanned, copied and decoded at
+    most once, and length is capped at MAX_NOTIFY_SIZE by the caller. So no input can
+    cost more than MAX_NOTIFY_SIZE bytes of framing plus MAX_NOTIFY_SIZE / MAX_RESPONSE_SIZE + 1
+    completed frames per notification, however corrupt it is.
+*/
+void KilovaultBmsBle::assemble_(const uint8_t *data, uint16_t length) {
+  const uint8_t *end = data + length;
+
+  while (data < end) {
+    if (this->framer_state_ == FramerState::SEEK_PREAMBLE) {
+      const uint8_t *preamble = std::find_if(data, end, is_preamble);
+      this->dropped_bytes_ += preamble - data;
+      if (preamble == end)
+        break;
+
+      this->decoder_.reset();
+      const uint8_t *frame_end = preamble + MAX_RESPONSE_SIZE;
+      if (end - preamble >= MAX_RESPONSE_SIZE && std::find_if(preamble + 1, frame_end, is_preamble) == frame_end) {
+        this->decoder_.advance(preamble, MAX_RESPONSE_SIZE);
+        data = frame_end;
+        this->complete_frame_();
+        continue;
+      }
+
+      this->frame_buffer_[0] = *preamble;
+      this->frame_length_ = 1;
+      this->framer_state_ = FramerState::IN_FRAME;
+      data = preamble + 1;
+      continue;
+    }
+
+    // Copy up to the end of the frame, stopping early if a preamble shows up.
+    size_t missing = MAX_RESPONSE_SIZE - this->frame_length_;
+    const uint8_t *stop = data + std::min<size_t>(missing, end - data);
+    const uint8_t *preamble = std::find_if(data, stop, is_preamble);
+    std::copy(data, preamble, this->frame_buffer_ + this->frame_length_);
+    this->frame_length_ += preamble - data;
+    this->decoder_.advance(this->frame_buffer_, this->frame_length_);
+    data = preamble;
+
+    if (preamble != stop) {
+      ESP_LOGD(TAG, "Preamble inside frame after %u bytes, resyncing", (unsigned) this->frame_length_);
+      this->resync_count_++;
+      this->dropped_bytes_ += this->frame_length_;
+      this->framer_state_ = FramerState::SEEK_PREAMBLE;
+      continue;
+    }
+
+    if (this->frame_length_ == MAX_RESPONSE_SIZE) {
+      this->framer_state_ = FramerState::SEEK_PREAMBLE;
+      this->complete_frame_();
+    }
+  }
+}
+
+/* ========================================================================= */
+/*
+  Drops any partially assembled frame. Called on disconnect so a frame cut off by the
+  link going down is not glued to the first bytes received after reconnecting.
+*/
+void KilovaultBmsBle::reset_framer_() {
+  if (this->framer_state_ == FramerState::IN_FRAME)
+    this->dropped_bytes_ += this->frame_length_;
+  this->frame_length_ = 0;
+  this->framer_state_ = FramerState::SEEK_PREAMBLE;
 }
 
 /* ========================================================================= */
-void KilovaultBmsBle::assemble_(const uint8_t *data, uint16_t length) {
+/*
+  Offers an MTU large enough to carry a whole frame per notification, which saves a
+  GATT callback and the radio overhead of every extra chunk. The local MTU is shared by
+  all connections of the node and has to be set before they open, so it is raised once
+  ble_client registered and never lowered: with several hubs the largest mtu wins.
+*/
+void KilovaultBmsBle::raise_local_mtu_() {
+  if (this->mtu_ <= local_mtu_)
+    return;
+
+  auto status = esp_ble_gatt_set_local_mtu(this->mtu_);
+  if (status) {
+    ESP_LOGW(TAG, "esp_ble_gatt_set_local_mtu failed, status=%d", status);
+    return;
+  }
+  local_mtu_ = this->mtu_;
+}
+
+/* ========================================================================= */
+/*
+  Fast path for a known battery. Registers for notifications with the handles saved
+  on an earlier connection, so frames start flowing while ble_client is still running
+  its service discovery. The handles are checked against the discovered ones in
+  subscribe_discovered_(), and a failed registration drops the cache.
+*/
+void KilovaultBmsBle::subscribe_cached_() {
+  ESP_LOGD(TAG, "[%s] Subscribing with cached handles (notify 0x%02X, command 0x%02X)",
+           this->parent_->address_str().c_str(), this->gatt_cache_.notify_handle, this->gatt_cache_.command_handle);
+  this->char_notify_handle_ = this->gatt_cache_.notify_handle;
+  this->char_command_handle_ = this->gatt_cache_.command_handle;
+
+  auto status = esp_ble_gattc_register_for_notify(this->parent_->get_gattc_if(), this->parent_->get_remote_bda(),
+                                                  this->gatt_cache_.notify_handle);
+  if (status) {
+    ESP_LOGW(TAG, "esp_ble_gattc_register_for_notify failed, status=%d", status);
+    this->gatt_cache_valid_ = false;
+    return;
+  }
+  this->gatt_cache_subscribed_ = true;
+}
 
-  // auto ascii_to_int = [] (const uint8_t c) {
-  //   uint8_t v = c;
-  //   if ((c >= 48) && (c <= 57))
-  //     v = (c - 48);
-  //   else if ((c >= 65) && (c <= 70))
-  //     v = (c - 65 + 10);
-  //   else if ((c >= 97) && (c <= 102))
-  //     v = (c - 97 + 10);   
-  //   return v;
-  // };
+/* ========================================================================= */
+/*
+  Full path, called once service discovery completed. Looks up the characteristics
+  and registers for notifications, unless the cached path already did so with the
+  same handle. The discovered handles are saved for the next connection.
+*/
+void KilovaultBmsBle::subscribe_discovered_() {
+  auto *char_notify =
+      this->parent_->get_characteristic(KILOVAULT_BMS_SERVICE_UUID, KILOVAULT_BMS_NOTIFY_CHARACTERISTIC_UUID);
+  if (char_notify == nullptr) {
+    ESP_LOGE(TAG, "[%s] No notify service found at device, not an KILOVAULT BMS..?",
+             this->parent_->address_str().c_str());
+    return;
+  }
+  this->char_notify_handle_ = char_notify->handle;
+
+  if (this->gatt_cache_subscribed_ && this->gatt_cache_.notify_handle == char_notify->handle) {
+    ESP_LOGV(TAG, "[%s] Cached notify handle confirmed", this->parent_->address_str().c_str());
+  } else {
+    if (this->gatt_cache_subscribed_) {
+      ESP_LOGW(TAG, "[%s] Cached notify handle 0x%02X is stale, device uses 0x%02X",
+               this->parent_->address_str().c_str(), this->gatt_cache_.notify_handle, char_notify->handle);
+      this->gatt_cache_subscribed_ = false;
+    }
+    auto status = esp_ble_gattc_register_for_notify(this->parent()->get_gattc_if(), this->parent()->get_remote_bda(),
+                                                    char_notify->handle);
+    if (status) {
+      ESP_LOGW(TAG, "esp_ble_gattc_register_for_notify failed, status=%d", status);
+    }
+  }
 
-  // Check the frame buffer size.
-  if (this->frame_buffer_.size() > MAX_RESPONSE_SIZE) {
-    ESP_LOGW(TAG, "Maximum response size exceeded");
-    this->frame_buffer_.clear();
+  auto *char_command =
+      this->parent_->get_characteristic(KILOVAULT_BMS_SERVICE_UUID, KILOVAULT_BMS_CONTROL_CHARACTERISTIC_UUID);
+  if (char_command == nullptr) {
+    ESP_LOGE(TAG, "[%s] No control service found at device, not an KILOVAULT BMS..?",
+             this->parent_->address_str().c_str());
+    return;
   }
+  this->char_command_handle_ = char_command->handle;
+
+  auto *cccd = this->parent_->get_config_descriptor(char_notify->handle);
+  if (cccd == nullptr)
+    return;
+
+  this->save_gatt_cache_({char_notify->handle, char_command->handle, cccd->handle});
+}
+
+/* ========================================================================= */
+/*
+  Saves the discovered handles. Only written when they differ from the cache, which
+  for a given battery happens once, so reconnects cost no flash wear.
+*/
+void KilovaultBmsBle::save_gatt_cache_(const GattCache &gatt_cache) {
+  if (!this->gatt_cache_enabled_)
+    return;
+  if (this->gatt_cache_valid_ && memcmp(&this->gatt_cache_, &gatt_cache, sizeof(GattCache)) == 0)
+    return;
+
+  this->gatt_cache_ = gatt_cache;
+  this->gatt_cache_valid_ = this->gatt_cache_pref_.save(&this->gatt_cache_);
+  ESP_LOGD(TAG, "[%s] Saved GATT handles (notify 0x%02X, command 0x%02X, cccd 0x%02X)",
+           this->parent_->address_str().c_str(), gatt_cache.notify_handle, gatt_cache.command_handle,
+           gatt_cache.cccd_handle);
+}
+
+/* ========================================================================= */
+/*
+  Holds ble_client off for a jittered exponential backoff after a lost or failed
+  connection. The delay doubles with every connection that did not deliver a frame,
+  up to reconnect_max_delay_, and only a random part of the upper half is waited on
+  top of the lower half, so several nodes that lost the same battery do not retry in
+  lockstep. The first frame of a connection resets the backoff.
+
+  A client disabled from elsewhere (e.g. the ble_client.disconnect action) or driven
+  by kilovault_scheduler is left alone.
+*/
+void KilovaultBmsBle::schedule_reconnect_() {
+  if (this->scheduled_ || !this->parent_->enabled)
+    return;
+
+  this->awaiting_first_frame_ = false;
+  uint32_t delay = this->reconnect_delay_;
+  for (uint8_t i = 0; i < this->reconnect_attempts_ && delay < this->reconnect_max_delay_; i++)
+    delay *= 2;
+  delay = std::min(delay, this->reconnect_max_delay_);
+  delay = delay / 2 + random_uint32() % (delay / 2 + 1);
+
+  if (this->reconnect_attempts_ < UINT8_MAX)
+    this->reconnect_attempts_++;
+  this->reconnect_count_++;
+
+  ESP_LOGD(TAG, "[%s] Reconnecting in %" PRIu32 " ms (attempt %u)", this->parent_->address_str().c_str(), delay,
+           this->reconnect_attempts_);
+  this->parent_->set_enabled(false);
+  this->set_timeout("reconnect", delay, [this]() { this->parent_->set_enabled(true); });
+}
 
-  // Flush buffer on every preamble. This indicated the start of a new packet.
-  if (data[0] == KILOVAULT_PKT_START_A || data[0] == KILOVAULT_PKT_START_B) {
-    this->frame_buffer_.clear();
+/* ========================================================================= */
+/*
+  Logs the captured notifications, oldest first, in a format meant to be parsed back:
+
+    capture begin <records> <bytes>
+    <timestamp ms> <length> <hex>
+      + <hex>                         (continuation, for notifications over 64 bytes)
+    capture end
+
+  Every notification keeps its own line, so a replay can feed assemble_() with the
+  exact chunk boundaries and timing of the capture.
+*/
+void KilovaultBmsBle::dump_capture() {
+  static const size_t BYTES_PER_LINE = 64;
+
+  if (!this->capture_.enabled()) {
+    ESP_LOGW(TAG, "[%s] Capture is disabled, set capture_size to enable it", this->parent_->address_str().c_str());
+    return;
   }
 
-  // Append the data to the frame buffer.
-  this->frame_buffer_.insert(this->frame_buffer_.end(), data, data + length);
-  //ESP_LOGW(TAG, "frame_buffer: %s", format_hex_pretty(this->frame_buffer_).c_str());
+  ESP_LOGI(TAG, "capture begin %u %u", (unsigned) this->capture_.size(), (unsigned) this->capture_.used());
+  this->capture_.for_each([](uint32_t timestamp, const uint8_t *data, uint16_t length) {
+    size_t first = std::min<size_t>(length, BYTES_PER_LINE);
+    ESP_LOGI(TAG, "%" PRIu32 " %u %s", timestamp, length, format_hex(data, first).c_str());
+    for (size_t offset = first; offset < length; offset += BYTES_PER_LINE) {
+      size_t count = std::min<size_t>(length - offset, BYTES_PER_LINE);
+      ESP_LOGI(TAG, "  + %s", format_hex(data + offset, count).c_str());
+    }
+  });
+  ESP_LOGI(TAG, "capture end");
+}
 
-  /* Process the frame buffer. 
-    if the size of frame_buffer_ is equal to MAX_RESPONSE_SIZE,
-    then convert the ascii to int and check the crc
-  */
-  if (this->frame_buffer_.size() == MAX_RESPONSE_SIZE) {
+/* ========================================================================= */
+/*
+  Called by assemble_() once a complete MAX_RESPONSE_SIZE frame arrived, either in
+  frame_buffer_ or in a single notification. decoder_ has already converted, summed and decoded the frame while it was arriving,
+  all that is left is to check it. Frames with a non-hex character or a checksum
+  mismatch are dropped, everything else is handed off for publishing.
+*/
+void KilovaultBmsBle::complete_frame_() {
+  this->frame_count_++;
+  this->frame_length_ = 0;
+
+  if (!this->decoder_.valid()) {
+    ESP_LOGW(TAG, "Non-hex character in frame, dropping it");
+    this->crc_failure_count_++;
+    return;
+  }
 
-    for(int i=0; i < this->frame_buffer_.size(); i++){
-      this->frame_buffer_[i] = this->ascii_to_int_(this->frame_buffer_[i]);
+  if (!this->decoder_.checksum_ok()) {
+    this->crc_failure_count_++;
+    ESP_LOGW(TAG, "CRC check failed! 0x%02X != 0x%02X", this->decoder_.checksum(), this->decoder_.remote_checksum());
+    return;
+  }
+
+#ifdef USE_KILOVAULT_DECODE_TASK
+  // On the decode task, leave the frame for loop()
+  if (this->decode_task_handle_ != nullptr) {
+    this->decoded_frame_.write({this->decoder_.data(), millis()});
+    return;
+  }
+#endif
+
+  // Hand off to on_kilovault_bms_ble_data_() for processing.
+  this->on_kilovault_bms_ble_data_(this->decoder_.data(), millis());
+}
+
+#ifdef USE_KILOVAULT_DECODE_TASK
+/* ========================================================================= */
+/*
+  Frames and decodes the queued notifications on its own core. While the task runs it
+  is the only writer of the framer, the decoder and the frame counters; the main loop
+  just reads the counters, a stale value only delays a diagnostic. Complete frames are
+  handed over through decoded_frame_, the decode times through decode_time_window_:
+  the task starts a fresh histogram whenever update() moved on to the next window.
+*/
+void KilovaultBmsBle::decode_task_(void *arg) {
+  auto *self = static_cast<KilovaultBmsBle *>(arg);
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    int length;
+    while ((length = self->decode_queue_.pop(self->decode_chunk_)) >= 0) {
+      // A gap: the link dropped or the queue overflowed, the partial frame is useless
+      if (length == 0) {
+        self->reset_framer_();
+        continue;
+      }
+#ifdef USE_KILOVAULT_DECODE_TIME
+      uint32_t started = micros();
+      self->assemble_(self->decode_chunk_, length);
+      uint32_t elapsed = micros() - started;
+      uint32_t window = self->decode_time_window_.load(std::memory_order_relaxed);
+      if (window != self->decode_time_task_.window)
+        self->decode_time_task_ = {window, {}};
+      self->decode_time_task_.histogram.add(elapsed);
+      self->decode_time_shared_.write(self->decode_time_task_);
+#else
+      self->assemble_(self->decode_chunk_, length);
+#endif
     }
+  }
+}
+#endif
 
-    // Check the CRC. If the CRC check fails, clear the frame buffer and return.
-    if (!crc(this->frame_buffer_)) {
-      //ESP_LOGW(TAG, "frame_buffer: %s", format_hex_pretty(this->frame_buffer_).c_str());
-      this->frame_buffer_.clear();
-      return;
+/* ========================================================================= */
+/*
+  Picks up the newest frame of the decode task. Frames the task completed in between
+  two loop() runs are overwritten and counted as overruns.
+*/
+void KilovaultBmsBle::loop() {
+#ifdef USE_KILOVAULT_DECODE_TASK
+  if (this->decode_task_handle_ == nullptr)
+    return;
+
+  DecodedFrame frame;
+  uint32_t sequence = this->decoded_frame_.read(frame);
+  if (sequence == this->decoded_sequence_)
+    return;
+
+  this->frame_overrun_count_ += (sequence - this->decoded_sequence_) / 2 - 1;
+  this->decoded_sequence_ = sequence;
+  this->on_kilovault_bms_ble_data_(frame.data, frame.timestamp);
+#endif
+}
+
+/* ========================================================================= */
+/*
+  Restores the charge and energy totals. They are stored per battery, keyed by the
+  MAC address, so several instances on one node keep separate totals. Frames are
+  integrated as long as they are at most two update intervals apart.
+*/
+void KilovaultBmsBle::setup() {
+#ifdef USE_KILOVAULT_ENERGY
+  this->energy_pref_ =
+      global_preferences->make_preference<EnergyTotals>(fnv1_hash("kilovault_energy_" + this->parent_->address_str()));
+  if (this->energy_pref_.load(&this->energy_.totals)) {
+    ESP_LOGD(TAG, "Restored energy totals: in %.3f Wh, out %.3f Wh",
+             EnergyIntegrator::to_hours(this->energy_.totals.energy_in),
+             EnergyIntegrator::to_hours(this->energy_.totals.energy_out));
+  }
+  this->energy_saved_ = this->energy_.totals;
+  this->energy_last_save_ = millis();
+  if (this->energy_max_gap_ == 0)
+    this->energy_.set_max_gap(std::max(ENERGY_MAX_GAP, 2 * this->get_update_interval()));
+#endif
+
+  if (this->capture_size_ > 0)
+    this->capture_.allocate(this->capture_size_);
+  this->command_queue_.reserve(COMMAND_QUEUE_SIZE);
+
+#ifdef USE_KILOVAULT_DECODE_TASK
+  if (this->decode_task_enabled_) {
+    this->decode_queue_.allocate(this->decode_queue_size_);
+    if (xTaskCreatePinnedToCore(decode_task_, "kilovault_decode", DECODE_TASK_STACK_SIZE, this,
+                                DECODE_TASK_PRIORITY, &this->decode_task_handle_, DECODE_TASK_CORE) != pdPASS) {
+      ESP_LOGE(TAG, "Creating the decode task failed, decoding in the BLE callback");
+      this->decode_task_handle_ = nullptr;
     }
+  }
+#endif
+
+  this->gatt_cache_pref_ =
+      global_preferences->make_preference<GattCache>(fnv1_hash("kilovault_gatt_" + this->parent_->address_str()));
+  if (this->gatt_cache_enabled_)
+    this->gatt_cache_valid_ = this->gatt_cache_pref_.load(&this->gatt_cache_);
+}
+
+/* ========================================================================= */
+void KilovaultBmsBle::on_shutdown() {
+#ifdef USE_KILOVAULT_ENERGY
+  this->save_energy_(true);
+#endif
+}
+
+/* ========================================================================= */
+/*
+  Publishes the charge and energy totals as total_increasing sensors.
+*/
+void KilovaultBmsBle::publish_energy_() {
+  const EnergyTotals &totals = this->energy_.totals;
+  this->publish_state_(this->charged_capacity_sensor_, EnergyIntegrator::to_hours(totals.charge_in));
+  this->publish_state_(this->discharged_capacity_sensor_, EnergyIntegrator::to_hours(totals.charge_out));
+  this->publish_state_(this->charged_energy_sensor_, EnergyIntegrator::to_hours(totals.energy_in));
+  this->publish_state_(this->discharged_energy_sensor_, EnergyIntegrator::to_hours(totals.energy_out));
+
+  this->save_energy_(false);
+}
+
+/* ========================================================================= */
+/*
+  Publishes the hot path diagnostics. The rates cover the time since the previous
+  update, the decode time percentiles the notifications received in it, so a gap in
+  the data can be told apart: no notifications is radio loss, CRC failures and resyncs
+  are corruption, and decode times going up point at CPU starvation.
+*/
+void KilovaultBmsBle::publish_diagnostics_() {
+  uint32_t now = millis();
+  uint32_t elapsed = now - this->rate_at_;
+  if (this->rate_at_ != 0 && elapsed > 0) {
+    this->publish_state_(this->notification_rate_sensor_,
+                         (this->notification_count_ - this->rate_notifications_) * 1000.0f / elapsed);
+    this->publish_state_(this->frame_rate_sensor_, (this->frame_count_ - this->rate_frames_) * 1000.0f / elapsed);
+  }
+  if (this->frame_count_ != this->rate_frames_) {
+    this->publish_state_(this->chunks_per_frame_sensor_, float(this->notification_count_ - this->rate_notifications_) /
+                                                             (this->frame_count_ - this->rate_frames_));
+  }
+  this->publish_state_(this->negotiated_mtu_sensor_, this->negotiated_mtu_);
+  this->rate_at_ = now;
+  this->rate_notifications_ = this->notification_count_;
+  this->rate_frames_ = this->frame_count_;
+
+  this->publish_state_(this->crc_failures_sensor_, this->crc_failure_count_);
+  this->publish_state_(this->oversize_drops_sensor_, this->oversize_count_);
+  this->publish_state_(this->resyncs_sensor_, this->resync_count_);
+  this->publish_state_(this->empty_frames_sensor_, this->empty_frame_count_);
+#ifdef USE_KILOVAULT_DECODE_TASK
+  this->publish_state_(this->queue_overflows_sensor_, this->decode_queue_.overflows());
+  this->publish_state_(this->frame_overruns_sensor_, this->frame_overrun_count_);
+#endif
+
+#ifdef USE_KILOVAULT_DECODE_TIME
+  LatencyHistogram decode_time = this->take_decode_time_();
+  if (decode_time.count > 0) {
+    this->publish_state_(this->decode_time_p50_sensor_, decode_time.percentile(0.50f));
+    this->publish_state_(this->decode_time_p95_sensor_, decode_time.percentile(0.95f));
+    this->publish_state_(this->decode_time_p99_sensor_, decode_time.percentile(0.99f));
+    ESP_LOGV(TAG, "Decode time over %" PRIu32 " notifications: p50 %.0f us, p99 %.0f us, max %" PRIu32 " us",
+             decode_time.count, decode_time.percentile(0.50f), decode_time.percentile(0.99f), decode_time.max);
+  }
+#endif
+}
+
+#ifdef USE_KILOVAULT_DECODE_TIME
+/* ========================================================================= */
+/*
+  Returns the decode times of the window that ends now and starts the next one. With
+  the decode task the histogram is the task's, update() only reads its latest copy and
+  bumps the window; a sample the task adds while the window moves on is lost.
+*/
+LatencyHistogram KilovaultBmsBle::take_decode_time_() {
+#ifdef USE_KILOVAULT_DECODE_TASK
+  if (this->decode_task_handle_ != nullptr) {
+    DecodeTimeWindow shared;
+    this->decode_time_shared_.read(shared);
+    uint32_t window = this->decode_time_window_.load(std::memory_order_relaxed);
+    this->decode_time_window_.store(window + 1, std::memory_order_relaxed);
+    return shared.window == window ? shared.histogram : LatencyHistogram{};
+  }
+#endif
+  LatencyHistogram decode_time = this->decode_time_;
+  this->decode_time_.reset();
+  return decode_time;
+}
+#endif
+
+/* ========================================================================= */
+/*
+  Writes the totals to flash. To limit flash wear this only happens once the save
+  interval has passed or the energy moved by more than the save delta (in Wh) since
+  the last save, and never when nothing changed.
+*/
+void KilovaultBmsBle::save_energy_(bool force) {
+  const EnergyTotals &totals = this->energy_.totals;
+  int64_t moved = (totals.energy_in - this->energy_saved_.energy_in) + (totals.energy_out - this->energy_saved_.energy_out);
+  bool changed = moved != 0 || totals.charge_in != this->energy_saved_.charge_in ||
+                 totals.charge_out != this->energy_saved_.charge_out;
+  if (!changed)
+    return;
+
+  uint32_t now = millis();
+  if (!force && now - this->energy_last_save_ < this->energy_save_interval_ &&
+      EnergyIntegrator::to_hours(moved) < this->energy_save_delta_)
+    return;
 
-    // Hand off to on_kilovault_bms_ble_data_() for processing.
-    this->on_kilovault_bms_ble_data_(this->frame_buffer_);
-    this->frame_buffer_.clear();
+  if (this->energy_pref_.save(&totals)) {
+    this->energy_saved_ = totals;
+    this->energy_last_save_ = now;
+    ESP_LOGV(TAG, "Saved energy totals");
   }
 }
 
 /* ========================================================================= */
+/*
+  Publishes the newest snapshot at the polling interval. Frames that arrived since
+  the last update were coalesced into it by on_kilovault_bms_ble_data_(), so the
+  publish rate no longer depends on how fast the BMS streams.
+*/
 void KilovaultBmsBle::update() {
+  if (this->snapshot_fresh_) {
+    const Snapshot &snapshot = this->snapshots_[this->snapshot_front_];
+    this->snapshot_fresh_ = false;
+    uint32_t latency = millis() - snapshot.timestamp;
+    ESP_LOGV(TAG, "Publishing snapshot from %" PRIu32 " ms ago, %" PRIu32 " frames coalesced", latency,
+             snapshot.coalesced);
+    this->decode_status_data_(snapshot.data);
+    this->publish_state_(this->publish_latency_sensor_, latency);
+  }
+#ifdef USE_KILOVAULT_WINDOWS
+  this->publish_windows_();
+#endif
+#ifdef USE_KILOVAULT_ENERGY
+  this->publish_energy_();
+#endif
+  this->publish_diagnostics_();
+#ifdef USE_KILOVAULT_CELL_TRENDS
+  this->publish_cell_trends_();
+#endif
+
+  if (this->time_to_first_frame_fresh_) {
+    this->time_to_first_frame_fresh_ = false;
+    ESP_LOGI(TAG, "[%s] First frame %" PRIu32 " ms after connecting", this->parent_->address_str().c_str(),
+             this->time_to_first_frame_);
+    this->publish_state_(this->time_to_first_frame_sensor_, this->time_to_first_frame_);
+  }
+
+  if (this->last_frame_at_ != 0) {
+    this->publish_state_(this->staleness_sensor_, (millis() - this->last_frame_at_) * 0.001f);
+    if (this->cycle_time_ != 0)
+      this->publish_state_(this->cycle_time_sensor_, this->cycle_time_ * 0.001f);
+  }
+
+  // A scheduled battery is disconnected most of the time, that is not worth a warning
   if (this->node_state != espbt::ClientState::ESTABLISHED ) {
-    ESP_LOGW(TAG, "[%s] Not connected", this->parent_->address_str().c_str());
+    if (!this->scheduled_)
+      ESP_LOGW(TAG, "[%s] Not connected", this->parent_->address_str().c_str());
     return;
   }
 
+  ESP_LOGD(TAG, "Frames: %" PRIu32 ", resyncs: %" PRIu32 ", dropped bytes: %" PRIu32, this->frame_count_,
+           this->resync_count_, this->get_dropped_bytes());
+
+  uint32_t publishes = this->published_count_ + this->suppressed_count_;
+  if (publishes > 0) {
+    ESP_LOGD(TAG, "Publishes: %" PRIu32 ", suppressed: %" PRIu32 " (%.1f%%)", this->published_count_,
+             this->suppressed_count_, this->suppressed_count_ * 100.0f / publishes);
+  }
+
+  // Publishes since the previous update, this one's included
+  uint32_t published = this->published_count_ - this->rate_published_;
+  uint32_t suppressed = this->suppressed_count_ - this->rate_suppressed_;
+  if (published + suppressed > 0)
+    this->publish_state_(this->publish_suppression_sensor_, suppressed * 100.0f / (published + suppressed));
+  this->rate_published_ = this->published_count_;
+  this->rate_suppressed_ = this->suppressed_count_;
 }
 
 /* ========================================================================= */
 /*
-  This can most likely be removed and call decode_status_data_ directly from 
-  the assemble_ function. Verified with copilot. There is a chance that on_kilovault_bms_ble_data
-  is some sort of built in from a library, but copilot does not seem to think so.
+  Called with every checksummed frame, from the BLE callback or, with the decode task,
+  from loop(). It only stores the frame in the back buffer and flips it to the front,
+  publishing is left to update(). A snapshot that was not published yet is replaced,
+  which coalesces the frames that arrive between two updates. An empty frame (status
+  0) carries no measurements, so it does not replace a valid snapshot that is still
+  waiting for update(), it is only counted.
 */
-void KilovaultBmsBle::on_kilovault_bms_ble_data_(const std::vector<uint8_t> &data) {
+void KilovaultBmsBle::on_kilovault_bms_ble_data_(const StatusData &status_data, uint32_t timestamp) {
+  if (this->awaiting_first_frame_) {
+    this->awaiting_first_frame_ = false;
+    this->reconnect_attempts_ = 0;
+    this->time_to_first_frame_ = timestamp - this->connected_at_;
+    this->time_to_first_frame_fresh_ = true;
+  }
+
+  if (status_data.status == 0)
+    this->empty_frame_count_++;
+
+  if (this->last_frame_at_ != 0)
+    this->cycle_time_ = timestamp - this->last_frame_at_;
+  this->last_frame_at_ = timestamp;
+
+  Snapshot &front = this->snapshots_[this->snapshot_front_];
+  if (status_data.status == 0 && this->snapshot_fresh_ && front.data.status != 0) {
+    front.coalesced++;
+  } else {
+    uint8_t back = this->snapshot_front_ ^ 1;
+    Snapshot &snapshot = this->snapshots_[back];
+    snapshot.data = status_data;
+    snapshot.timestamp = timestamp;
+    snapshot.coalesced = this->snapshot_fresh_ ? front.coalesced + 1 : 1;
+
+    this->snapshot_front_ = back;
+    this->snapshot_fresh_ = true;
+  }
 
-  this->decode_status_data_(data);
+#ifdef USE_KILOVAULT_WINDOWS
+  this->update_windows_(status_data);
+#endif
 
+#ifdef USE_KILOVAULT_ENERGY
+  if (status_data.status != 0) {
+    this->energy_.add(timestamp, status_data.current, frame_power_mw(status_data));
+  }
+#endif
+
+#ifdef USE_KILOVAULT_CELL_TRENDS
+  this->update_cell_trends_(status_data, timestamp);
+#endif
+
+  // The fast path, these do not wait for update()
+#ifdef USE_KILOVAULT_STATUS_BITS
+  this->publish_status_bits_(status_data);
+#endif
+#ifdef USE_KILOVAULT_ALARMS
+  this->check_alarms_(status_data);
+#endif
+
+  this->status_callback_.call(status_data);
 }
 
 /* ========================================================================= */
-void KilovaultBmsBle::decode_status_data_(const std::vector<uint8_t> &data) {
-  /*
-    &data is an array that contains all of the data from the battery. This 
-    function processes each element of the array and publishes it appropriately.
+/*
+  Adds every frame to the statistics of the current publish window, so the
+  transients between two publishes still show up in min/max/mean/RMS.
+  Frames with status 0 are skipped, same as in decode_status_data_().
+*/
+#ifdef USE_KILOVAULT_WINDOWS
+void KilovaultBmsBle::update_windows_(const StatusData &status_data) {
+  if (status_data.status == 0)
+    return;
 
-    TODO: Add debug code to see the data in the array. It would be great to 
-    dump this out and document what all the fields are. Maybe there are ID's in it?
-  */
+  if (this->windows_[WINDOW_VOLTAGE].enabled)
+    this->windows_[WINDOW_VOLTAGE].stats.add(layout::Voltage::to_float(status_data.voltage));
+  if (this->windows_[WINDOW_CURRENT].enabled)
+    this->windows_[WINDOW_CURRENT].stats.add(layout::Current::to_float(status_data.current));
+  if (this->windows_[WINDOW_POWER].enabled)
+    this->windows_[WINDOW_POWER].stats.add(frame_power_mw(status_data) * 0.001f);
+
+  for (uint8_t i = 0; i < CELL_COUNT; i++) {
+    Window &window = this->windows_[WINDOW_CELL_VOLTAGE_1 + i];
+    if (window.enabled)
+      window.stats.add(layout::CellVoltages::to_float(status_data.cell_voltages[i]));
+  }
+}
 
-  // Log each value of the array.
-  // for (size_t i = 0; i < data.size(); i++) {
-  //   ESP_LOGW(TAG, "data[%d] = %d", i, data[i]);
-  // }
+/* ========================================================================= */
+/*
+  Publishes the statistics of the window that just ended and starts a new one.
+*/
+void KilovaultBmsBle::publish_windows_() {
+  for (auto &window : this->windows_) {
+    if (!window.enabled || window.stats.count == 0)
+      continue;
+
+    this->publish_state_(window.sensors[STATISTIC_MIN], window.stats.min);
+    this->publish_state_(window.sensors[STATISTIC_MAX], window.stats.max);
+    this->publish_state_(window.sensors[STATISTIC_MEAN], window.stats.mean);
+    this->publish_state_(window.sensors[STATISTIC_RMS], window.stats.rms());
+    window.stats.reset();
+  }
+}
+#endif
 
+#ifdef USE_KILOVAULT_CELL_TRENDS
+/* ========================================================================= */
+/*
+  Updates the per-cell trends with every frame, in constant time and memory.
 
-  /* kilovault_get_16bit lambda function
-    This function captures all variables from the enclosing scope by reference,
-    specifically &data. It takes in a size_t i and returns a uint16_t.
+  Internal resistance: when the pack current moved by at least the current step since
+  the previous frame, the voltage change of each cell over the same interval is one
+  sample of its resistance. Frames more than RESISTANCE_MAX_GAP apart are not paired,
+  the state of charge drifts too far in between.
 
-    It does bitwise shifts of each element in the &data array.
-    The bitwise OR (|) effectively concats the bits from the four elements in the array
-    into a single 16bit value. 
-  
-  */
-  auto kilovault_get_16bit = [&](size_t i) -> uint16_t {
-    return (uint16_t(data[i + 2]) << 12) | (uint16_t(data[i + 3]) << 8) | (uint16_t(data[i + 0]) << 4) | (uint16_t(data[i + 1]) << 0);
-  };
+  Deviation: a moving average of each cell's offset from the pack mean. Its weight
+  follows the time between frames, so the time constant holds at any frame rate.
+*/
+void KilovaultBmsBle::update_cell_trends_(const StatusData &status_data, uint32_t now) {
+  if (status_data.status == 0)
+    return;
 
-  /* kilovault_get_32bit lambda function
-    Does the same thing as above, but combines two 16 bit values into a single 32 bit value.
-  
-  */
-  auto kilovault_get_32bit = [&](size_t i) -> uint32_t {
-    return (uint32_t(kilovault_get_16bit(i + 4)) << 16) | (uint32_t(kilovault_get_16bit(i + 0)) << 0);
-  };
+  uint32_t sum = 0;
+  uint8_t cells = 0;
+  for (uint16_t cell_voltage : status_data.cell_voltages) {
+    if (cell_voltage > 0) {
+      sum += cell_voltage;
+      cells++;
+    }
+  }
+  if (cells == 0)
+    return;
+  float mean = (float) sum / cells;  // mV
+
+  uint32_t dt = now - this->trend_previous_at_;
+  bool paired = this->trend_previous_at_ != 0 && dt <= RESISTANCE_MAX_GAP;
+  float current_step = (status_data.current - this->trend_previous_.current) * 0.001f;  // A
+  bool stepped = paired && std::abs(current_step) >= this->resistance_current_step_;
+  float weight = this->trend_previous_at_ == 0 ? 1.0f : (float) dt / (this->deviation_time_constant_ + dt);
+
+  for (uint8_t i = 0; i < CELL_COUNT; i++) {
+    uint16_t cell_voltage = status_data.cell_voltages[i];
+    if (cell_voltage == 0)
+      continue;
+
+    Cell &cell = this->cells_[i];
+    uint16_t previous_voltage = this->trend_previous_.cell_voltages[i];
+    if (stepped && previous_voltage > 0)
+      cell.resistance.add(current_step, (cell_voltage - previous_voltage) * 0.001f, RESISTANCE_FORGETTING);
+    cell.deviation.add(cell_voltage - mean, weight);
+  }
+
+  this->trend_previous_ = status_data;
+  this->trend_previous_at_ = now;
+}
+
+/* ========================================================================= */
+void KilovaultBmsBle::publish_cell_trends_() {
+  for (auto &cell : this->cells_) {
+    if (cell.resistance.count >= RESISTANCE_MIN_SAMPLES)
+      this->publish_state_(cell.cell_resistance_sensor_, cell.resistance.resistance() * 1000.0f);  // mOhm
+    if (!std::isnan(cell.deviation.value))
+      this->publish_state_(cell.cell_deviation_sensor_, cell.deviation.value);  // mV
+  }
+}
+#endif
+
+#ifdef USE_KILOVAULT_STATUS_BITS
+/* ========================================================================= */
+/*
+  Publishes the status and AFE status words bit by bit, on every frame but only for
+  the bits that changed. The first frame publishes all of them, empty frames none.
+*/
+void KilovaultBmsBle::publish_status_bits_(const StatusData &status_data) {
+  if (status_data.status == 0)
+    return;
+
+  uint16_t status = status_data.status;
+  uint16_t afe_status = status_data.afe_status;
+  uint16_t status_changed = this->status_bits_known_ ? status ^ this->last_status_ : 0xFFFF;
+  uint16_t afe_status_changed = this->status_bits_known_ ? afe_status ^ this->last_afe_status_ : 0xFFFF;
+  if (status_changed == 0 && afe_status_changed == 0)
+    return;
+
+  ESP_LOGD(TAG, "Status 0x%04X, AFE status 0x%04X", status, afe_status);
+  for (uint8_t bit = 0; bit < STATUS_BITS; bit++) {
+    if (status_changed & (1 << bit))
+      this->publish_state_(this->status_bit_binary_sensors_[bit], (status >> bit) & 1);
+    if (afe_status_changed & (1 << bit))
+      this->publish_state_(this->afe_status_bit_binary_sensors_[bit], (afe_status >> bit) & 1);
+  }
+
+  this->last_status_ = status;
+  this->last_afe_status_ = afe_status;
+  this->status_bits_known_ = true;
+}
+#endif
+
+#ifdef USE_KILOVAULT_ALARMS
+/* ========================================================================= */
+/*
+  Checks every frame against the hard limits, in the raw units of the frame. A newly
+  broken limit publishes the offending sensor right away, past its publish filter,
+  and fires on_alarm, so it is seen within one frame instead of one update interval.
+*/
+void KilovaultBmsBle::check_alarms_(const StatusData &status_data) {
+  if (status_data.status == 0)
+    return;
 
-  //ESP_LOGI(TAG, "Status frame (%d+4 bytes):", data.size());
-  //ESP_LOGD(TAG, "  %s", format_hex_pretty(&data.front(), data.size()).c_str());
-  //this->publish_state_(this->message_text_sensor_, format_hex_pretty(&data.front(), 80).c_str());
-  ESP_LOGI(TAG, "AFESTATUS (RAW): %X", data[41]);
-  ESP_LOGI(TAG, "AFESTATUS (16b): %X", kilovault_get_16bit(41));
-  this->publish_state_(this->afestatus_sensor_, kilovault_get_16bit(41));
+  CellVoltageRange range = frame_cell_voltage_range(status_data);
+
+  uint8_t active = 0;
+  if (status_data.current > this->max_charge_current_)
+    active |= 1 << ALARM_CHARGE_CURRENT;
+  if (-int64_t(status_data.current) > this->max_discharge_current_)
+    active |= 1 << ALARM_DISCHARGE_CURRENT;
+  if (range.min_cell != 0 && range.min < this->min_cell_voltage_limit_)
+    active |= 1 << ALARM_CELL_UNDERVOLTAGE;
+  if (range.max > this->max_cell_voltage_limit_)
+    active |= 1 << ALARM_CELL_OVERVOLTAGE;
+  if (status_data.temperature < this->min_temperature_limit_)
+    active |= 1 << ALARM_UNDER_TEMPERATURE;
+  if (status_data.temperature > this->max_temperature_limit_)
+    active |= 1 << ALARM_OVER_TEMPERATURE;
+
+  uint8_t raised = active & ~this->alarms_;
+  uint8_t cleared = this->alarms_ & ~active;
+  if (raised == 0 && cleared == 0 && this->alarms_known_)
+    return;
+  this->alarms_ = active;
+  this->alarms_known_ = true;
+  this->publish_state_(this->alarm_binary_sensor_, active != 0);
+
+  for (uint8_t alarm = 0; alarm < ALARM_COUNT; alarm++) {
+    if (cleared & (1 << alarm))
+      ESP_LOGI(TAG, "[%s] Alarm %s cleared", this->parent_->address_str().c_str(), ALARM_NAMES[alarm]);
+    if (!(raised & (1 << alarm)))
+      continue;
+
+    float value;
+    sensor::Sensor *sensor;
+    switch (alarm) {
+      case ALARM_CHARGE_CURRENT:
+      case ALARM_DISCHARGE_CURRENT:
+        value = layout::Current::to_float(status_data.current);
+        sensor = this->current_sensor_;
+        break;
+      case ALARM_CELL_UNDERVOLTAGE:
+        value = layout::CellVoltages::to_float(range.min);
+        sensor = this->min_cell_voltage_sensor_;
+        break;
+      case ALARM_CELL_OVERVOLTAGE:
+        value = layout::CellVoltages::to_float(range.max);
+        sensor = this->max_cell_voltage_sensor_;
+        break;
+      default:
+        value = frame_temperature_centi_celsius(status_data) * 0.01f;
+        sensor = this->temperature_sensor_;
+        break;
+    }
 
-  int16_t status = kilovault_get_16bit(37);
-  this->publish_state_(this->status_sensor_, status);
+    ESP_LOGW(TAG, "[%s] Alarm %s: %.3f", this->parent_->address_str().c_str(), ALARM_NAMES[alarm], value);
+    this->publish_state_(sensor, value, true);
+    this->alarm_callback_.call(ALARM_NAMES[alarm], value);
+  }
+}
+#endif
 
-  if (status == 0) {
+/* ========================================================================= */
+void KilovaultBmsBle::decode_status_data_(const StatusData &status_data) {
+  /*
+    status_data holds the raw values of a checksummed frame, pulled out by the frame
+    layout in kilovault_frame.h while the frame was arriving. The field offsets, widths
+    and scale factors live in that layout, this function only publishes the values and
+    the ones derived from them.
+  */
+#ifdef USE_KILOVAULT_AFESTATUS
+  this->publish_state_(this->afestatus_sensor_, status_data.afe_status);
+#endif
+
+#ifdef USE_KILOVAULT_STATUS
+  this->publish_state_(this->status_sensor_, status_data.status);
+#endif
+
+  if (status_data.status == 0) {
     return;
   }
 
   /*
-    If the current is greater than 2147483647, then subtract 4294967295 from the current. 
-    This is done to handle the overflow of the current. This is necessary because electrical
-    current can have negative values indicating reverse current flow and the system might
-    be using unsigned integers to represent these values. This ensures that the current 
-    value is correctly interpreted as a signed integer. 
+    Everything below works on the raw integer units of the frame (mV, mA, mAh, 0.1 K)
+    and on the integer values derived from them in kilovault_frame.h. The layout scales
+    a value to a float only when it is published.
+
+    The current is a signed 32 bit value, negative while discharging. The layout
+    reads it as two's complement so no further sign fixup is needed.
   */
-  int32_t current = kilovault_get_32bit(9);
-  if (current > 2147483647) {
-     current = current - 4294967295;
-  } 
-  
+#ifdef USE_KILOVAULT_CURRENT
   // Publish the state of the CURRENT sensor.
-  // TODO: ?? Store the value of CURRENT and reuse it for POWER calculation
-  this->publish_state_(this->current_sensor_, (float) current * 0.001f);
+  this->publish_state_(this->current_sensor_, layout::Current::to_float(status_data.current));
+#endif
 
-  //  8    4  0xCE 0x61 0x00 0x00  Total voltage                    V     0.001f
   /*
-    Likely that the voltage is retrieved in millivolts. This scales it to volts 
-    by multiplying by 0.001. The f on the end of 0.001f indicates that the literal
-    is a float and not a double.
+    The voltage is sent in millivolts, the layout scales it to volts.
   */
-  float voltage = kilovault_get_16bit(1) * 0.001f;
+#ifdef USE_KILOVAULT_VOLTAGE
   // Publish the state of the VOLTAGE sensor
-  this->publish_state_(this->voltage_sensor_, voltage);
+  this->publish_state_(this->voltage_sensor_, layout::Voltage::to_float(status_data.voltage));
+#endif
 
   /*
-    Power is in watts. Using ohms law we multiple voltage by the current. 
-    We could probably store this from the current calculations above and 
-    reuse it here. 
+    Power in mW. Using ohms law we multiply the voltage by the current, exactly, in
+    integers, and only the published value is scaled to watts.
   */
-  float power = voltage * ((float) current * 0.001f);
+#ifdef KILOVAULT_DECODE_POWER
+  int64_t power = frame_power_mw(status_data);
+#endif
 
+#ifdef USE_KILOVAULT_POWER
   // Publish the state of the POWER sensor
-  this->publish_state_(this->power_sensor_, power);
+  this->publish_state_(this->power_sensor_, power * 0.001f);
+#endif
   
+#ifdef USE_KILOVAULT_CHARGING_POWER
   // Publish the state of the CHARGING POWER sensor
-  this->publish_state_(this->charging_power_sensor_, std::max(0.0f, power));               // 500W vs 0W -> 500W
+  this->publish_state_(this->charging_power_sensor_, std::max<int64_t>(0, power) * 0.001f);      // 500W vs 0W -> 500W
+#endif
 
+#ifdef USE_KILOVAULT_DISCHARGING_POWER
   // Publish the state of the DISCHARGING POWER sensor
-  this->publish_state_(this->discharging_power_sensor_, std::abs(std::min(0.0f, power)));  // -500W vs 0W -> 500W
+  this->publish_state_(this->discharging_power_sensor_, -std::min<int64_t>(0, power) * 0.001f);  // -500W vs 0W -> 500W
+#endif
 
+#ifdef USE_KILOVAULT_TOTAL_CAPACITY
   // Publish the state of the TOTAL CAPACITY sensor
-  this->publish_state_(this->total_capacity_sensor_, kilovault_get_32bit(17) * 0.001f);
-
-  // Publish the state of the CURRENT CAPACITY sensor
-  this->publish_state_(this->current_capacity_sensor_, (kilovault_get_32bit(17) * 0.001f) * (kilovault_get_16bit(29) * 0.01f));
+  this->publish_state_(this->total_capacity_sensor_, layout::TotalCapacity::to_float(status_data.total_capacity));
+#endif
+
+#ifdef USE_KILOVAULT_CURRENT_CAPACITY
+  // Publish the state of the CURRENT CAPACITY sensor, mAh scaled like the total capacity
+  this->publish_state_(this->current_capacity_sensor_,
+                       layout::TotalCapacity::to_float(frame_remaining_capacity_mah(status_data)));
+#endif
   
+#ifdef USE_KILOVAULT_CYCLES
   // Publish the state of the CYCLES sensor
-  this->publish_state_(this->cycles_sensor_, kilovault_get_16bit(25));
+  this->publish_state_(this->cycles_sensor_, layout::Cycles::to_float(status_data.cycles));
+#endif
 
+#ifdef USE_KILOVAULT_STATE_OF_CHARGE
   // Publish the state of the STATE OF CHARGE sensor
-  this->publish_state_(this->state_of_charge_sensor_, kilovault_get_16bit(29));
+  this->publish_state_(this->state_of_charge_sensor_, layout::StateOfCharge::to_float(status_data.state_of_charge));
+#endif
   
-  // temp is in Kelvin covert to Celius
-  int16_t temp = kilovault_get_16bit(33);
-
-  // Publish the state of the TEMPERATURE sensor
-  this->publish_state_(this->temperature_sensor_, (temp * 0.1f) - 273.15);
+#ifdef USE_KILOVAULT_TEMPERATURE
+  // Publish the state of the TEMPERATURE sensor, temp is in Kelvin covert to Celius
+  this->publish_state_(this->temperature_sensor_, frame_temperature_centi_celsius(status_data) * 0.01f);
+#endif
 
+#ifdef USE_KILOVAULT_CELL_VOLTAGES
   // Decode the cell voltages data and handle publishing in that function
-  this->decode_cell_voltages_data_(data);
-
-  // Publish the state of the BATTERY MAC text sensor
-  this->publish_state_(this->battery_mac_text_sensor_, this->parent_->address_str().c_str());
+  this->decode_cell_voltages_data_(status_data);
+#endif
+
+#ifdef USE_KILOVAULT_BATTERY_MAC
+  // Publish the state of the BATTERY MAC text sensor, once per connection since
+  // address_str() builds a new string every time
+  if (!this->battery_mac_published_) {
+    this->battery_mac_published_ = true;
+    this->publish_state_(this->battery_mac_text_sensor_, this->parent_->address_str());
+  }
+#endif
 
 }
 
 /* ========================================================================= */
-void KilovaultBmsBle::decode_cell_voltages_data_(const std::vector<uint8_t> &data) {
-
-/* 
-  Maybe create this as a function since it is used in multiple places.
-*/
-  auto kilovault_get_16bit = [&](size_t i) -> uint16_t {
-    return (uint16_t(data[i + 2]) << 12) | (uint16_t(data[i + 3]) << 8) | (uint16_t(data[i + 0]) << 4) | (uint16_t(data[i + 1]) << 0);
-  };
-
-  uint8_t offset = 1;
-  uint8_t cells = 4;
-  uint8_t start = 41;
-
-  //ESP_LOGI(TAG, "Cell voltages frame (chunk %d, %d+4 bytes):", data[2] - 36, data.size());
-  //ESP_LOGD(TAG, "  %s", format_hex_pretty(&data.front(), data.size()).c_str());
-
-  this->min_cell_voltage_ = 100.0f;
-  this->max_cell_voltage_ = -100.0f;
-  
+void KilovaultBmsBle::decode_cell_voltages_data_(const StatusData &status_data) {
   /*
-    What I think this is doing is getting the cell voltage for each cell. Cell data
-    looks like it starts at index 41 and is 4 bytes long in the &data array.
-
-    It then makes sure that the min and max cell voltages are correct. 
-    then sends it to publish. 
+    The cell voltages were pulled out of the frame by the layout. This keeps track
+    of the min and max cell voltages, in mV, and publishes every cell. CELL_COUNT is
+    a compile time constant, so the loops are sized (and unrolled) for the configured pack.
   */
-  for (uint8_t i = 1; i <= cells; i++) {
-    float cell_voltage = kilovault_get_16bit(start + (i * 4)) * 0.001f;
-
-    if (cell_voltage > 0 && cell_voltage < this->min_cell_voltage_) {
-      this->min_cell_voltage_ = cell_voltage;
-      this->min_voltage_cell_ = i ;
-    }
-
-    if (cell_voltage > this->max_cell_voltage_) {
-      this->max_cell_voltage_ = cell_voltage;
-      this->max_voltage_cell_ = i ;
-    }
-    this->publish_state_(this->cells_[i-1].cell_voltage_sensor_, cell_voltage);
+  CellVoltageRange range = frame_cell_voltage_range(status_data);
+  this->min_cell_voltage_ = range.min;
+  this->max_cell_voltage_ = range.max;
+  this->min_voltage_cell_ = range.min_cell;
+  this->max_voltage_cell_ = range.max_cell;
+
+  for (uint8_t i = 0; i < CELL_COUNT; i++) {
+    this->publish_state_(this->cells_[i].cell_voltage_sensor_,
+                         layout::CellVoltages::to_float(status_data.cell_voltages[i]));
   }
 
-  this->publish_state_(this->min_cell_voltage_sensor_, this->min_cell_voltage_);
-  this->publish_state_(this->max_cell_voltage_sensor_, this->max_cell_voltage_);
+  // No cell connected leaves no minimum
+  bool has_min = range.min_cell != 0;
+  this->publish_state_(this->min_cell_voltage_sensor_, has_min ? layout::CellVoltages::to_float(range.min) : NAN);
+  this->publish_state_(this->max_cell_voltage_sensor_, layout::CellVoltages::to_float(range.max));
   this->publish_state_(this->max_voltage_cell_sensor_, (float) this->max_voltage_cell_);
-  this->publish_state_(this->min_voltage_cell_sensor_, (float) this->min_voltage_cell_);
-  this->publish_state_(this->delta_cell_voltage_sensor_, this->max_cell_voltage_ - this->min_cell_voltage_);
+  this->publish_state_(this->min_voltage_cell_sensor_, has_min ? (float) this->min_voltage_cell_ : NAN);
+  this->publish_state_(this->delta_cell_voltage_sensor_,
+                       has_min ? layout::CellVoltages::to_float(range.max - range.min) : NAN);
 }
 
 /* ========================================================================= */
@@ -418,6 +1316,7 @@ void KilovaultBmsBle::decode_cell_voltages_data_(const std::vector<uint8_t> &dat
 */
 void KilovaultBmsBle::dump_config() {  // NOLINT(google-readability-function-size,readability-function-size)
   ESP_LOGCONFIG(TAG, "KilovaultBmsBle:");
+  ESP_LOGCONFIG(TAG, "  Cells: %u", CELL_COUNT);
 
 
   LOG_SENSOR("", "Voltage", voltage_sensor_);
@@ -437,13 +1336,67 @@ void KilovaultBmsBle::dump_config() {  // NOLINT(google-readability-function-siz
   LOG_SENSOR("", "Max voltage cell", max_voltage_cell_sensor_);
   LOG_SENSOR("", "Delta cell voltage", delta_cell_voltage_sensor_);
   LOG_SENSOR("", "Temperature", temperature_sensor_);
-  LOG_SENSOR("", "Cell Voltage 1", this->cells_[0].cell_voltage_sensor_);
-  LOG_SENSOR("", "Cell Voltage 2", this->cells_[1].cell_voltage_sensor_);
-  LOG_SENSOR("", "Cell Voltage 3", this->cells_[2].cell_voltage_sensor_);
-  LOG_SENSOR("", "Cell Voltage 4", this->cells_[3].cell_voltage_sensor_);
+  LOG_SENSOR("", "Charged capacity", charged_capacity_sensor_);
+  LOG_SENSOR("", "Discharged capacity", discharged_capacity_sensor_);
+  LOG_SENSOR("", "Charged energy", charged_energy_sensor_);
+  LOG_SENSOR("", "Discharged energy", discharged_energy_sensor_);
+  LOG_SENSOR("", "Time to first frame", time_to_first_frame_sensor_);
+  LOG_SENSOR("", "Staleness", staleness_sensor_);
+  LOG_SENSOR("", "Cycle time", cycle_time_sensor_);
+  LOG_SENSOR("", "Notification rate", notification_rate_sensor_);
+  LOG_SENSOR("", "Frame rate", frame_rate_sensor_);
+  LOG_SENSOR("", "CRC failures", crc_failures_sensor_);
+  LOG_SENSOR("", "Oversize drops", oversize_drops_sensor_);
+  LOG_SENSOR("", "Resyncs", resyncs_sensor_);
+  LOG_SENSOR("", "Empty frames", empty_frames_sensor_);
+  LOG_SENSOR("", "Publish latency", publish_latency_sensor_);
+  LOG_SENSOR("", "Decode time p50", decode_time_p50_sensor_);
+  LOG_SENSOR("", "Decode time p95", decode_time_p95_sensor_);
+  LOG_SENSOR("", "Decode time p99", decode_time_p99_sensor_);
+  LOG_SENSOR("", "Queue overflows", queue_overflows_sensor_);
+  LOG_SENSOR("", "Frame overruns", frame_overruns_sensor_);
+  LOG_SENSOR("", "Negotiated MTU", negotiated_mtu_sensor_);
+  LOG_SENSOR("", "Chunks per frame", chunks_per_frame_sensor_);
+  for (auto &cell : this->cells_) {
+    LOG_SENSOR("", "Cell Voltage", cell.cell_voltage_sensor_);
+#ifdef USE_KILOVAULT_CELL_TRENDS
+    LOG_SENSOR("", "Cell Resistance", cell.cell_resistance_sensor_);
+    LOG_SENSOR("", "Cell Deviation", cell.cell_deviation_sensor_);
+#endif
+  }
+  ESP_LOGCONFIG(TAG, "  Resistance current step: %.1f A", this->resistance_current_step_);
+  ESP_LOGCONFIG(TAG, "  Deviation time constant: %" PRIu32 " ms", this->deviation_time_constant_);
+
+  LOG_BINARY_SENSOR("", "Alarm", this->alarm_binary_sensor_);
+#ifdef USE_KILOVAULT_STATUS_BITS
+  for (uint8_t bit = 0; bit < STATUS_BITS; bit++) {
+    LOG_BINARY_SENSOR("", "Status bit", this->status_bit_binary_sensors_[bit]);
+    LOG_BINARY_SENSOR("", "AFE status bit", this->afe_status_bit_binary_sensors_[bit]);
+  }
+#endif
+
+  LOG_SWITCH("", "Charging", this->charging_switch_);
+  LOG_SWITCH("", "Discharging", this->discharging_switch_);
 
   LOG_TEXT_SENSOR("", "Battery MAC", this->battery_mac_text_sensor_);
   LOG_TEXT_SENSOR("", "Message", this->message_text_sensor_);
+
+  ESP_LOGCONFIG(TAG, "  Publish filters: %u", (unsigned) this->publish_filters_.size());
+  ESP_LOGCONFIG(TAG, "  Frames: %" PRIu32 ", resyncs: %" PRIu32 ", dropped bytes: %" PRIu32, this->frame_count_,
+                this->resync_count_, this->get_dropped_bytes());
+  ESP_LOGCONFIG(TAG, "  Notifications: %" PRIu32 ", CRC failures: %" PRIu32 ", oversize drops: %" PRIu32
+                ", empty frames: %" PRIu32, this->notification_count_, this->crc_failure_count_,
+                this->oversize_count_, this->empty_frame_count_);
+  ESP_LOGCONFIG(TAG, "  MTU: %u requested, %u negotiated", this->mtu_, this->negotiated_mtu_);
+  ESP_LOGCONFIG(TAG, "  GATT cache: %s",
+                !this->gatt_cache_enabled_ ? "disabled" : (this->gatt_cache_valid_ ? "valid" : "empty"));
+  ESP_LOGCONFIG(TAG, "  Reconnect delay: %" PRIu32 " ms, max %" PRIu32 " ms, reconnects: %" PRIu32,
+                this->reconnect_delay_, this->reconnect_max_delay_, this->reconnect_count_);
+  ESP_LOGCONFIG(TAG, "  Capture: %u bytes", (unsigned) this->capture_.capacity());
+#ifdef USE_KILOVAULT_DECODE_TASK
+  ESP_LOGCONFIG(TAG, "  Decode task: %s, queue %u bytes", YESNO(this->decode_task_handle_ != nullptr),
+                (unsigned) this->decode_queue_.capacity());
+#endif
 }
 
 /* ========================================================================= */
@@ -459,16 +1412,54 @@ void KilovaultBmsBle::publish_state_(binary_sensor::BinarySensor *binary_sensor,
   binary_sensor->publish_state(state);
 }
 
+/* ========================================================================= */
+/*
+  Decides whether a filtered sensor has to be published. A value is published when
+  there is no previous one, when it moved by more than the deadband, or when the
+  heartbeat interval has passed since the last publish.
+*/
+static bool passes_filter(const float last_value, const uint32_t last_publish, const float value,
+                          const float deadband, const float relative_deadband, const uint32_t heartbeat,
+                          const uint32_t now) {
+  if (std::isnan(last_value) || std::isnan(value))
+    return std::isnan(last_value) != std::isnan(value);
+
+  if (heartbeat > 0 && now - last_publish >= heartbeat)
+    return true;
+
+  float threshold = std::max(deadband, relative_deadband * std::abs(last_value));
+  return std::abs(value - last_value) > threshold;
+}
+
 /* ========================================================================= */
 /*
   This function is used to publish the state of the sensor. 
   The function takes in a sensor::Sensor object and a float value. 
   If the sensor object is not null, the function publishes the state of the sensor. 
+
+  Sensors with a publish filter (set_publish_filter()) are only published when the
+  value passes the filter, everything else is counted as suppressed.
 */
-void KilovaultBmsBle::publish_state_(sensor::Sensor *sensor, float value) {
+void KilovaultBmsBle::publish_state_(sensor::Sensor *sensor, float value, bool bypass_filter) {
   if (sensor == nullptr)
     return;
 
+  for (auto &filter : this->publish_filters_) {
+    if (filter.sensor != sensor)
+      continue;
+
+    uint32_t now = millis();
+    if (!bypass_filter && !passes_filter(filter.last_value, filter.last_publish, value, filter.deadband, filter.relative_deadband,
+                       filter.heartbeat, now)) {
+      this->suppressed_count_++;
+      return;
+    }
+    filter.last_value = value;
+    filter.last_publish = now;
+    break;
+  }
+
+  this->published_count_++;
   sensor->publish_state(value);
 }
 
@@ -476,12 +1467,19 @@ void KilovaultBmsBle::publish_state_(sensor::Sensor *sensor, float value) {
 /*
   This function is used to publish the state of the text sensor. 
   The function takes in a text_sensor::TextSensor object and a string value. 
-  If the text sensor object is not null, the function publishes the state of the text sensor.
+  If the text sensor object is not null and the text changed, the function
+  publishes the state of the text sensor.
 */
 void KilovaultBmsBle::publish_state_(text_sensor::TextSensor *text_sensor, const std::string &state) {
   if (text_sensor == nullptr)
     return;
 
+  if (text_sensor->has_state() && text_sensor->state == state) {
+    this->suppressed_count_++;
+    return;
+  }
+
+  this->published_count_++;
   text_sensor->publish_state(state);
 }
 
@@ -500,18 +1498,118 @@ void KilovaultBmsBle::publish_state_(switch_::Switch *obj, const bool &state) {
 
 /* ========================================================================= */
 /*
-  This clearly does nothing, and is not called from anywhere. 
+  Queues a register write and returns right away, nothing here waits on the radio.
+
+  A write to a register that already has one waiting replaces its value, so toggling
+  a switch a few times before the BMS answered only sends the last state. Both
+  callbacks are kept and called with the outcome, the newest first, so rollbacks end
+  at the state from before the first write.
+  When the queue is full, no write command is configured or the value does not fit the
+  single value byte of a command frame, the write is refused and the callback told so
+  immediately.
+*/
+void KilovaultBmsBle::write_register(uint8_t address, uint16_t value, std::function<void(bool)> &&callback) {
+  if (!this->writes_enabled_ || value > 0xFF) {
+    ESP_LOGW(TAG, "[%s] Refusing write of 0x%04X to register 0x%02X%s", this->parent_->address_str().c_str(), value,
+             address, this->writes_enabled_ ? ", the value is a single byte" : ", no write command configured");
+    if (callback)
+      callback(false);
+    return;
+  }
+
+  for (size_t i = this->command_in_flight_ ? 1 : 0; i < this->command_queue_.size(); i++) {
+    Command &command = this->command_queue_[i];
+    if (command.address == address) {
+      ESP_LOGV(TAG, "Coalescing write to register 0x%02X: 0x%02X -> 0x%02X", address, command.value, value);
+      command.value = value;
+      command.attempts = 0;
+      if (callback && command.callback) {
+        command.callback = [newer = std::move(callback), older = std::move(command.callback)](bool success) {
+          newer(success);
+          older(success);
+        };
+      } else if (callback) {
+        command.callback = std::move(callback);
+      }
+      return;
+    }
+  }
+
+  if (this->command_queue_.size() >= COMMAND_QUEUE_SIZE) {
+    ESP_LOGW(TAG, "[%s] Command queue full, dropping write to register 0x%02X", this->parent_->address_str().c_str(),
+             address);
+    if (callback)
+      callback(false);
+    return;
+  }
+
+  this->command_queue_.push_back({address, uint8_t(value), 0, std::move(callback)});
+  this->send_next_command_();
+}
+
+/* ========================================================================= */
+/*
+  Sends the command at the front of the queue, unless one is in flight already or the
+  link is not up. The write asks for a response, so ESP_GATTC_WRITE_CHAR_EVT tells
+  whether it arrived. Without one within command_timeout_ the write is retried, and a
+  write the stack refused right away is retried without waiting.
 */
-void KilovaultBmsBle::write_register(uint8_t address, uint16_t value) {
-  // this->send_command_(KILOVAULT_CMD_WRITE, KILOVAULT_CMD_MOS);  // @TODO: Pass value
+void KilovaultBmsBle::send_next_command_() {
+  if (this->command_in_flight_ || this->command_queue_.empty())
+    return;
+  if (this->node_state != espbt::ClientState::ESTABLISHED || this->char_command_handle_ == 0)
+    return;
+
+  Command &command = this->command_queue_.front();
+  command.attempts++;
+  this->command_in_flight_ = true;
+  if (!this->send_command_(this->write_command_, command.address, command.value)) {
+    this->retry_command_();
+    return;
+  }
+  this->set_timeout("command", this->command_timeout_, [this]() {
+    ESP_LOGW(TAG, "[%s] No response to write to register 0x%02X", this->parent_->address_str().c_str(),
+             this->command_queue_.front().address);
+    this->retry_command_();
+  });
+}
+
+/* ========================================================================= */
+void KilovaultBmsBle::retry_command_() {
+  this->cancel_timeout("command");
+  this->command_in_flight_ = false;
+
+  if (this->command_queue_.front().attempts > this->command_retries_) {
+    this->finish_command_(false);
+    return;
+  }
+  this->send_next_command_();
 }
 
 /* ========================================================================= */
 /*
-  This is not called anywhere other than write_register.  Maybe it was an experiement 
-  to write data to the battery. Maybe the original author tried it and it didnt work.
+  Removes the front command and reports the outcome, then moves on to the next one.
+*/
+void KilovaultBmsBle::finish_command_(bool success) {
+  this->cancel_timeout("command");
+  this->command_in_flight_ = false;
+
+  Command command = std::move(this->command_queue_.front());
+  this->command_queue_.erase(this->command_queue_.begin());
+  ESP_LOGD(TAG, "[%s] Write of 0x%02X to register 0x%02X %s after %u attempt(s)",
+           this->parent_->address_str().c_str(), command.value, command.address, success ? "done" : "failed",
+           command.attempts);
+  if (command.callback)
+    command.callback(success);
+
+  this->send_next_command_();
+}
 
-  It was attempting to use the ESP BLE api to send data to the battery.
+/* ========================================================================= */
+/*
+  Builds a command frame and writes it to the control characteristic. Only called by
+  send_next_command_(), the outcome arrives as ESP_GATTC_WRITE_CHAR_EVT, which is why
+  the write asks for a response.
 */
 bool KilovaultBmsBle::send_command_(uint8_t start_of_frame, uint8_t function, uint8_t value) {
   uint8_t frame[9];
@@ -533,7 +1631,7 @@ bool KilovaultBmsBle::send_command_(uint8_t start_of_frame, uint8_t function, ui
 
   auto status =
       esp_ble_gattc_write_char(this->parent_->get_gattc_if(), this->parent_->get_conn_id(), this->char_command_handle_,
-                               sizeof(frame), frame, ESP_GATT_WRITE_TYPE_NO_RSP, ESP_GATT_AUTH_REQ_NONE);
+                               sizeof(frame), frame, ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
 
   if (status) {
     ESP_LOGW(TAG, "[%s] esp_ble_gattc_write_char failed, status=%d", this->parent_->address_str().c_str(), status);
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "esphome/core/automation.h"
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/preferences.h"
 #include "esphome/components/ble_client/ble_client.h"
 #include "esphome/components/esp32_ble_tracker/esp32_ble_tracker.h"
 #include "esphome/components/binary_sensor/binary_sensor.h"
@@ -11,18 +16,65 @@
 #ifdef USE_ESP32
 
 #include <esp_gattc_api.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "kilovault_capture.h"
+#include "kilovault_frame.h"
+#include "kilovault_queue.h"
+#include "kilovault_stats.h"
+
+#ifdef USE_KILOVAULT_DECODE_TASK
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
 
 namespace esphome {
 namespace kilovault_bms_ble {
 
 namespace espbt = esphome::esp32_ble_tracker;
 
+// Quantities tracked over every publish window, the CELL_COUNT cells follow WINDOW_CELL_VOLTAGE_1.
+enum WindowChannel : uint8_t {
+  WINDOW_VOLTAGE = 0,
+  WINDOW_CURRENT,
+  WINDOW_POWER,
+  WINDOW_CELL_VOLTAGE_1,
+  WINDOW_CHANNEL_COUNT = WINDOW_CELL_VOLTAGE_1 + CELL_COUNT,
+};
+
+// Hard limits checked on every frame, see check_alarms_()
+enum Alarm : uint8_t {
+  ALARM_CHARGE_CURRENT = 0,
+  ALARM_DISCHARGE_CURRENT,
+  ALARM_CELL_UNDERVOLTAGE,
+  ALARM_CELL_OVERVOLTAGE,
+  ALARM_UNDER_TEMPERATURE,
+  ALARM_OVER_TEMPERATURE,
+  ALARM_COUNT,
+};
+
+// Bits in the status and AFE status words
+static constexpr uint8_t STATUS_BITS = 16;
+
+enum WindowStatistic : uint8_t {
+  STATISTIC_MIN = 0,
+  STATISTIC_MAX,
+  STATISTIC_MEAN,
+  STATISTIC_RMS,
+  STATISTIC_COUNT,
+};
+
 class KilovaultBmsBle : public esphome::ble_client::BLEClientNode, public PollingComponent {
  public:
   void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
                            esp_ble_gattc_cb_param_t *param) override;
+  void setup() override;
   void dump_config() override;
   void update() override;
+  void loop() override;
+  void on_shutdown() override;
   float get_setup_priority() const override { return setup_priority::DATA; }
 
 
@@ -48,6 +100,17 @@ class KilovaultBmsBle : public esphome::ble_client::BLEClientNode, public Pollin
     current_capacity_sensor_ = current_capacity_sensor;
   }
   void set_status_sensor(sensor::Sensor *status_sensor) { status_sensor_ = status_sensor; }
+  void set_alarm_binary_sensor(binary_sensor::BinarySensor *alarm_binary_sensor) {
+    alarm_binary_sensor_ = alarm_binary_sensor;
+  }
+#ifdef USE_KILOVAULT_STATUS_BITS
+  void set_status_bit_binary_sensor(uint8_t bit, binary_sensor::BinarySensor *status_bit_binary_sensor) {
+    this->status_bit_binary_sensors_[bit] = status_bit_binary_sensor;
+  }
+  void set_afe_status_bit_binary_sensor(uint8_t bit, binary_sensor::BinarySensor *afe_status_bit_binary_sensor) {
+    this->afe_status_bit_binary_sensors_[bit] = afe_status_bit_binary_sensor;
+  }
+#endif
   void set_afestatus_sensor(sensor::Sensor *afestatus_sensor) { afestatus_sensor_ = afestatus_sensor; }
 
   void set_min_cell_voltage_sensor(sensor::Sensor *min_cell_voltage_sensor) {
@@ -68,9 +131,109 @@ class KilovaultBmsBle : public esphome::ble_client::BLEClientNode, public Pollin
   void set_cell_voltage_sensor(uint8_t cell, sensor::Sensor *cell_voltage_sensor) {
     this->cells_[cell].cell_voltage_sensor_ = cell_voltage_sensor;
   }
+#ifdef USE_KILOVAULT_CELL_TRENDS
+  void set_cell_resistance_sensor(uint8_t cell, sensor::Sensor *cell_resistance_sensor) {
+    this->cells_[cell].cell_resistance_sensor_ = cell_resistance_sensor;
+  }
+  void set_cell_deviation_sensor(uint8_t cell, sensor::Sensor *cell_deviation_sensor) {
+    this->cells_[cell].cell_deviation_sensor_ = cell_deviation_sensor;
+  }
+#endif
+#ifdef USE_KILOVAULT_WINDOWS
+  void set_window_sensor(uint8_t channel, uint8_t statistic, sensor::Sensor *window_sensor) {
+    this->windows_[channel].sensors[statistic] = window_sensor;
+    this->windows_[channel].enabled = true;
+  }
+#endif
+  void set_charged_capacity_sensor(sensor::Sensor *charged_capacity_sensor) {
+    charged_capacity_sensor_ = charged_capacity_sensor;
+  }
+  void set_discharged_capacity_sensor(sensor::Sensor *discharged_capacity_sensor) {
+    discharged_capacity_sensor_ = discharged_capacity_sensor;
+  }
+  void set_charged_energy_sensor(sensor::Sensor *charged_energy_sensor) {
+    charged_energy_sensor_ = charged_energy_sensor;
+  }
+  void set_discharged_energy_sensor(sensor::Sensor *discharged_energy_sensor) {
+    discharged_energy_sensor_ = discharged_energy_sensor;
+  }
+  void set_energy_save_interval(uint32_t energy_save_interval) { energy_save_interval_ = energy_save_interval; }
+  void set_energy_save_delta(float energy_save_delta) { energy_save_delta_ = energy_save_delta; }
+  // Frames further apart than this are not integrated into the totals. Derived from the
+  // update interval unless set, kilovault_scheduler sets it to cover a rotation.
+  void set_energy_max_gap(uint32_t energy_max_gap) {
+    this->energy_max_gap_ = energy_max_gap;
+    this->energy_.set_max_gap(energy_max_gap);
+  }
   void set_temperature_sensor(sensor::Sensor *temperature_sensor) {
     temperature_sensor_ = temperature_sensor;
   }
+  void set_publish_suppression_sensor(sensor::Sensor *publish_suppression_sensor) {
+    publish_suppression_sensor_ = publish_suppression_sensor;
+  }
+  void set_time_to_first_frame_sensor(sensor::Sensor *time_to_first_frame_sensor) {
+    time_to_first_frame_sensor_ = time_to_first_frame_sensor;
+  }
+  void set_staleness_sensor(sensor::Sensor *staleness_sensor) { staleness_sensor_ = staleness_sensor; }
+  void set_cycle_time_sensor(sensor::Sensor *cycle_time_sensor) { cycle_time_sensor_ = cycle_time_sensor; }
+  void set_notification_rate_sensor(sensor::Sensor *notification_rate_sensor) {
+    notification_rate_sensor_ = notification_rate_sensor;
+  }
+  void set_frame_rate_sensor(sensor::Sensor *frame_rate_sensor) { frame_rate_sensor_ = frame_rate_sensor; }
+  void set_crc_failures_sensor(sensor::Sensor *crc_failures_sensor) { crc_failures_sensor_ = crc_failures_sensor; }
+  void set_oversize_drops_sensor(sensor::Sensor *oversize_drops_sensor) {
+    oversize_drops_sensor_ = oversize_drops_sensor;
+  }
+  void set_resyncs_sensor(sensor::Sensor *resyncs_sensor) { resyncs_sensor_ = resyncs_sensor; }
+  void set_empty_frames_sensor(sensor::Sensor *empty_frames_sensor) { empty_frames_sensor_ = empty_frames_sensor; }
+  void set_publish_latency_sensor(sensor::Sensor *publish_latency_sensor) {
+    publish_latency_sensor_ = publish_latency_sensor;
+  }
+  void set_decode_time_p50_sensor(sensor::Sensor *decode_time_p50_sensor) {
+    decode_time_p50_sensor_ = decode_time_p50_sensor;
+  }
+  void set_decode_time_p95_sensor(sensor::Sensor *decode_time_p95_sensor) {
+    decode_time_p95_sensor_ = decode_time_p95_sensor;
+  }
+  void set_decode_time_p99_sensor(sensor::Sensor *decode_time_p99_sensor) {
+    decode_time_p99_sensor_ = decode_time_p99_sensor;
+  }
+  void set_queue_overflows_sensor(sensor::Sensor *queue_overflows_sensor) {
+    queue_overflows_sensor_ = queue_overflows_sensor;
+  }
+  void set_frame_overruns_sensor(sensor::Sensor *frame_overruns_sensor) {
+    frame_overruns_sensor_ = frame_overruns_sensor;
+  }
+  void set_negotiated_mtu_sensor(sensor::Sensor *negotiated_mtu_sensor) {
+    negotiated_mtu_sensor_ = negotiated_mtu_sensor;
+  }
+  void set_chunks_per_frame_sensor(sensor::Sensor *chunks_per_frame_sensor) {
+    chunks_per_frame_sensor_ = chunks_per_frame_sensor;
+  }
+
+
+  void set_gatt_cache(bool gatt_cache) { gatt_cache_enabled_ = gatt_cache; }
+  void set_mtu(uint16_t mtu) { mtu_ = mtu; }
+  void set_reconnect_delay(uint32_t reconnect_delay) { reconnect_delay_ = reconnect_delay; }
+  void set_reconnect_max_delay(uint32_t reconnect_max_delay) { reconnect_max_delay_ = reconnect_max_delay; }
+
+  // Connections are driven by kilovault_scheduler, which enables and disables the
+  // ble_client. The reconnect backoff stays out of its way.
+  void set_scheduled(bool scheduled) { scheduled_ = scheduled; }
+
+  // Keep the most recent raw notifications in a ring buffer of this many bytes, 0 disables it.
+  void set_capture_size(uint32_t capture_size) { capture_size_ = capture_size; }
+  void set_resistance_current_step(float resistance_current_step) {
+    resistance_current_step_ = resistance_current_step;
+  }
+  void set_deviation_time_constant(uint32_t deviation_time_constant) {
+    deviation_time_constant_ = deviation_time_constant;
+  }
+  void dump_capture();
+  bool is_scheduled() const { return this->scheduled_; }
+
+  void set_charging_switch(switch_::Switch *charging_switch) { charging_switch_ = charging_switch; }
+  void set_discharging_switch(switch_::Switch *discharging_switch) { discharging_switch_ = discharging_switch; }
 
   void set_battery_mac_text_sensor(text_sensor::TextSensor *battery_mac_text_sensor) {
     battery_mac_text_sensor_ = battery_mac_text_sensor;
@@ -80,9 +243,118 @@ class KilovaultBmsBle : public esphome::ble_client::BLEClientNode, public Pollin
     message_text_sensor_ = message_text_sensor;
   }
 
-  void write_register(uint8_t address, uint16_t value);
+  // Queues a register write, see send_next_command_(). callback is called once with
+  // the outcome, after the write was acknowledged or all retries failed. Writes are
+  // refused until the command byte that starts a write frame is set.
+  void write_register(uint8_t address, uint16_t value, std::function<void(bool)> &&callback = nullptr);
+  void set_write_command(uint8_t write_command) {
+    write_command_ = write_command;
+    writes_enabled_ = true;
+  }
+  void set_command_timeout(uint32_t command_timeout) { command_timeout_ = command_timeout; }
+  void set_command_retries(uint8_t command_retries) { command_retries_ = command_retries; }
+  void set_decode_task(bool decode_task) { decode_task_enabled_ = decode_task; }
+
+  // Limits in A, V and °C, kept in the raw units of the frame
+  void set_max_charge_current_limit(float current) { max_charge_current_ = lroundf(current * 1000.0f); }
+  void set_max_discharge_current_limit(float current) { max_discharge_current_ = lroundf(current * 1000.0f); }
+  void set_min_cell_voltage_limit(float voltage) { min_cell_voltage_limit_ = lroundf(voltage * 1000.0f); }
+  void set_max_cell_voltage_limit(float voltage) { max_cell_voltage_limit_ = lroundf(voltage * 1000.0f); }
+  void set_min_temperature_limit(float temperature) {
+    min_temperature_limit_ = lroundf(temperature * 10.0f + 2731.5f);
+  }
+  void set_max_temperature_limit(float temperature) {
+    max_temperature_limit_ = lroundf(temperature * 10.0f + 2731.5f);
+  }
+  void add_on_alarm_callback(std::function<void(const std::string &, float)> &&callback) {
+    this->alarm_callback_.add(std::move(callback));
+  }
+  void set_decode_queue_size(uint32_t decode_queue_size) { decode_queue_size_ = decode_queue_size; }
+
+  // Called with every checksummed frame, as it arrives. Used by kilovault_bank.
+  void add_on_status_callback(std::function<void(const StatusData &)> &&callback) {
+    this->status_callback_.add(std::move(callback));
+  }
+
+  // Only publish `sensor` when it moved by more than deadband (absolute) or relative_deadband
+  // (fraction of the last published value), or when heartbeat ms passed since the last publish.
+  void set_publish_filter(sensor::Sensor *sensor, float deadband, float relative_deadband, uint32_t heartbeat) {
+    this->publish_filters_.push_back({sensor, deadband, relative_deadband, heartbeat});
+  }
+
+  uint32_t get_published_count() const { return this->published_count_; }
+  uint32_t get_suppressed_count() const { return this->suppressed_count_; }
+
+  // Framer counters. Resyncs are frames abandoned because a new preamble showed up before
+  // the frame was complete, dropped bytes are everything that never made it into a frame.
+  uint32_t get_frame_count() const { return this->frame_count_; }
+  uint32_t get_resync_count() const { return this->resync_count_; }
+  uint32_t get_dropped_bytes() const { return this->dropped_bytes_ + this->oversize_bytes_; }
+
+  // Hot path counters. CRC failures include frames with a non-hex character, empty
+  // frames are the ones with status 0 that carry no measurements.
+  uint32_t get_notification_count() const { return this->notification_count_; }
+  uint32_t get_crc_failure_count() const { return this->crc_failure_count_; }
+  uint32_t get_oversize_count() const { return this->oversize_count_; }
+  uint32_t get_empty_frame_count() const { return this->empty_frame_count_; }
+
+  // Link counters. Time to first frame is measured from the connection opening to the
+  // first checksummed frame, 0 until one arrived.
+  uint32_t get_reconnect_count() const { return this->reconnect_count_; }
+  uint32_t get_time_to_first_frame() const { return this->time_to_first_frame_; }
+
+  // Time since the last checksummed frame and between the last two, 0 until known.
+  uint32_t get_staleness() const { return this->last_frame_at_ == 0 ? 0 : millis() - this->last_frame_at_; }
+  uint32_t get_cycle_time() const { return this->cycle_time_; }
 
  protected:
+  enum class FramerState : uint8_t {
+    SEEK_PREAMBLE,  // Discarding bytes until a preamble shows up
+    IN_FRAME,       // Preamble seen, collecting the rest of the frame
+  };
+
+  // Latest decoded frame, written by the BLE callback and published by update()
+  struct Snapshot {
+    StatusData data;
+    uint32_t timestamp;  // millis() when the frame was completed
+    uint32_t coalesced;  // Frames received since the previous publish
+  };
+
+  // A checksummed frame handed from the decode task to the main loop
+  struct DecodedFrame {
+    StatusData data;
+    uint32_t timestamp;  // millis() when the frame was completed
+  };
+
+  // Decode times the task measured in one publish window
+  struct DecodeTimeWindow {
+    uint32_t window;
+    LatencyHistogram histogram;
+  };
+
+  // GATT handles of the BMS, saved per MAC so a known battery can subscribe right away
+  struct GattCache {
+    uint16_t notify_handle;
+    uint16_t command_handle;
+    uint16_t cccd_handle;  // Client characteristic configuration of the notify characteristic
+  };
+
+  // A register write waiting in the command queue
+  struct Command {
+    uint8_t address;
+    uint8_t value;
+    uint8_t attempts;
+    std::function<void(bool)> callback;
+  };
+
+  struct PublishFilter {
+    sensor::Sensor *sensor;
+    float deadband;
+    float relative_deadband;
+    uint32_t heartbeat;
+    float last_value{NAN};
+    uint32_t last_publish{0};
+  };
 
   sensor::Sensor *voltage_sensor_;
   sensor::Sensor *current_sensor_;
@@ -101,36 +373,227 @@ class KilovaultBmsBle : public esphome::ble_client::BLEClientNode, public Pollin
   sensor::Sensor *max_voltage_cell_sensor_;
   sensor::Sensor *delta_cell_voltage_sensor_;
   sensor::Sensor *temperature_sensor_;
+  sensor::Sensor *publish_suppression_sensor_;
+  sensor::Sensor *charged_capacity_sensor_;
+  sensor::Sensor *discharged_capacity_sensor_;
+  sensor::Sensor *charged_energy_sensor_;
+  sensor::Sensor *discharged_energy_sensor_;
+  sensor::Sensor *time_to_first_frame_sensor_{nullptr};
+  sensor::Sensor *staleness_sensor_{nullptr};
+  sensor::Sensor *cycle_time_sensor_{nullptr};
+  sensor::Sensor *notification_rate_sensor_{nullptr};
+  sensor::Sensor *frame_rate_sensor_{nullptr};
+  sensor::Sensor *crc_failures_sensor_{nullptr};
+  sensor::Sensor *oversize_drops_sensor_{nullptr};
+  sensor::Sensor *resyncs_sensor_{nullptr};
+  sensor::Sensor *empty_frames_sensor_{nullptr};
+  sensor::Sensor *publish_latency_sensor_{nullptr};
+  sensor::Sensor *decode_time_p50_sensor_{nullptr};
+  sensor::Sensor *decode_time_p95_sensor_{nullptr};
+  sensor::Sensor *decode_time_p99_sensor_{nullptr};
+  sensor::Sensor *queue_overflows_sensor_{nullptr};
+  sensor::Sensor *frame_overruns_sensor_{nullptr};
+  sensor::Sensor *negotiated_mtu_sensor_{nullptr};
+  sensor::Sensor *chunks_per_frame_sensor_{nullptr};
+
+  binary_sensor::BinarySensor *alarm_binary_sensor_{nullptr};
+#ifdef USE_KILOVAULT_STATUS_BITS
+  binary_sensor::BinarySensor *status_bit_binary_sensors_[STATUS_BITS]{};
+  binary_sensor::BinarySensor *afe_status_bit_binary_sensors_[STATUS_BITS]{};
+  uint16_t last_status_{0};
+  uint16_t last_afe_status_{0};
+  bool status_bits_known_{false};
+#endif
+
+  // Hard limits in the raw units of the frame, the defaults never trip
+  int32_t max_charge_current_{INT32_MAX};     // mA
+  int32_t max_discharge_current_{INT32_MAX};  // mA, positive
+  uint16_t min_cell_voltage_limit_{0};        // mV
+  uint16_t max_cell_voltage_limit_{UINT16_MAX};
+  int16_t min_temperature_limit_{INT16_MIN};  // 0.1 K
+  int16_t max_temperature_limit_{INT16_MAX};
+  uint8_t alarms_{0};  // Bit per Alarm that is active
+  bool alarms_known_{false};
+  CallbackManager<void(const std::string &, float)> alarm_callback_;
+
+  switch_::Switch *charging_switch_{nullptr};
+  switch_::Switch *discharging_switch_{nullptr};
 
   text_sensor::TextSensor *battery_mac_text_sensor_;
   text_sensor::TextSensor *message_text_sensor_;
 
   struct Cell {
     sensor::Sensor *cell_voltage_sensor_{nullptr};
-  } cells_[4];
+#ifdef USE_KILOVAULT_CELL_TRENDS
+    sensor::Sensor *cell_resistance_sensor_{nullptr};
+    sensor::Sensor *cell_deviation_sensor_{nullptr};
+    ResistanceEstimator resistance;
+    Ewma deviation;  // mV from the pack mean
+#endif
+  } cells_[CELL_COUNT];
+
+#ifdef USE_KILOVAULT_CELL_TRENDS
+  // The frame the next one is compared against for the cell trends
+  StatusData trend_previous_{};
+  uint32_t trend_previous_at_{0};
+#endif
+  float resistance_current_step_{2.0f};
+  uint32_t deviation_time_constant_{3600000};
+
+#ifdef USE_KILOVAULT_WINDOWS
+  // Statistics of every frame received in the current publish window
+  struct Window {
+    WindowStats stats;
+    sensor::Sensor *sensors[STATISTIC_COUNT]{};
+    bool enabled{false};
+  } windows_[WINDOW_CHANNEL_COUNT];
+#endif
+
+  // The frame being assembled, fixed size so the notify path never allocates
+  uint8_t frame_buffer_[MAX_RESPONSE_SIZE]{};
+  size_t frame_length_{0};
+  FrameDecoder<layout_v1::Layout> decoder_;
+
+  Snapshot snapshots_[2]{};
+  uint8_t snapshot_front_{0};
+  bool snapshot_fresh_{false};
+
+  // Coulomb counting and energy totals, restored from flash on boot
+  EnergyIntegrator energy_;
+  ESPPreferenceObject energy_pref_;
+  EnergyTotals energy_saved_{};
+  uint32_t energy_last_save_{0};
+  uint32_t energy_save_interval_{900000};
+  float energy_save_delta_{10.0f};
+  uint32_t energy_max_gap_{0};  // 0 derives it from the update interval
+
+  // Cached GATT handles and the subscribe state of the current connection
+  bool gatt_cache_enabled_{true};
+  bool gatt_cache_valid_{false};
+  bool gatt_cache_subscribed_{false};
+  GattCache gatt_cache_{};
+
+  // ATT MTU asked for on every connection, and the one the BMS agreed to
+  uint16_t mtu_{247};
+  uint16_t negotiated_mtu_{ESP_GATT_DEF_BLE_MTU_SIZE};
+  // Local MTU of the node, the largest mtu_ of all hubs
+  static uint16_t local_mtu_;
+  ESPPreferenceObject gatt_cache_pref_;
+
+  // Reconnect backoff, reset by the first frame of a connection
+  uint32_t reconnect_delay_{1000};
+  uint32_t reconnect_max_delay_{120000};
+  uint8_t reconnect_attempts_{0};
+  uint32_t reconnect_count_{0};
+  uint32_t connected_at_{0};
+  bool awaiting_first_frame_{false};
+  uint32_t time_to_first_frame_{0};
+  bool time_to_first_frame_fresh_{false};
+  bool battery_mac_published_{false};
+  bool scheduled_{false};
+
+  // Frame timing, for staleness and cycle time
+  uint32_t last_frame_at_{0};
+  uint32_t cycle_time_{0};
+
+  // Raw notifications for dump_capture(), allocated in setup()
+  CaptureBuffer capture_;
+  uint32_t capture_size_{0};
+
+  // Bounded command queue, the front entry is the one in flight
+  std::vector<Command> command_queue_;
+  bool command_in_flight_{false};
+  uint32_t command_timeout_{2000};
+  uint8_t command_retries_{2};
+  uint8_t write_command_{0};
+  bool writes_enabled_{false};
 
-  std::vector<uint8_t> frame_buffer_;
-  uint16_t char_notify_handle_;
-  uint16_t char_command_handle_;
+  CallbackManager<void(const StatusData &)> status_callback_;
+
+  std::vector<PublishFilter> publish_filters_;
+  uint32_t published_count_{0};
+  uint32_t suppressed_count_{0};
+  // Counts at the previous update, for the share of the last interval
+  uint32_t rate_published_{0};
+  uint32_t rate_suppressed_{0};
+  FramerState framer_state_{FramerState::SEEK_PREAMBLE};
+  uint32_t frame_count_{0};
+  uint32_t resync_count_{0};
+  uint32_t dropped_bytes_{0};
+  uint32_t notification_count_{0};
+  uint32_t crc_failure_count_{0};
+  uint32_t oversize_count_{0};
+  uint32_t oversize_bytes_{0};
+  uint32_t empty_frame_count_{0};
+
+  // Rates are computed over the time between two updates
+  uint32_t rate_at_{0};
+  uint32_t rate_notifications_{0};
+  uint32_t rate_frames_{0};
+
+  // Time spent in assemble_() per notification, over the current publish window
+  LatencyHistogram decode_time_;
+
+  // Decode task: notifications are queued raw, framed and decoded on the other core and
+  // the frames picked up by loop()
+  bool decode_task_enabled_{false};
+  uint32_t decode_queue_size_{2048};
+#ifdef USE_KILOVAULT_DECODE_TASK
+  TaskHandle_t decode_task_handle_{nullptr};
+  SpscRing decode_queue_;
+  uint8_t decode_chunk_[MAX_NOTIFY_SIZE];
+  Seqlock<DecodedFrame> decoded_frame_;
+  uint32_t decoded_sequence_{0};
+  // The task's decode times, for the window update() is at
+  DecodeTimeWindow decode_time_task_{};
+  Seqlock<DecodeTimeWindow> decode_time_shared_;
+  std::atomic<uint32_t> decode_time_window_{0};
+  uint32_t frame_overrun_count_{0};
+
+  static void decode_task_(void *arg);
+#endif
+  uint16_t char_notify_handle_{0};
+  uint16_t char_command_handle_{0};
   uint8_t next_command_{5};
 
-  float min_cell_voltage_{100.0f};
-  float max_cell_voltage_{-100.0f};
+  uint16_t min_cell_voltage_{UINT16_MAX};  // mV
+  uint16_t max_cell_voltage_{0};
   uint8_t max_voltage_cell_{0};
   uint8_t min_voltage_cell_{0};
 
-  uint8_t ascii_to_int_(const uint8_t c);
   void assemble_(const uint8_t *data, uint16_t length);
-  void on_kilovault_bms_ble_data_(const std::vector<uint8_t> &data);
-  void decode_status_data_(const std::vector<uint8_t> &data);
+  void reset_framer_();
+  void raise_local_mtu_();
+  void subscribe_cached_();
+  void subscribe_discovered_();
+  void save_gatt_cache_(const GattCache &gatt_cache);
+  void schedule_reconnect_();
+  void complete_frame_();
+  void on_kilovault_bms_ble_data_(const StatusData &status_data, uint32_t timestamp);
+  void decode_status_data_(const StatusData &status_data);
   void decode_general_info_data_(const std::vector<uint8_t> &data);
-  void decode_cell_voltages_data_(const std::vector<uint8_t> &data);
+  void decode_cell_voltages_data_(const StatusData &status_data);
+  void update_windows_(const StatusData &status_data);
+  void update_cell_trends_(const StatusData &status_data, uint32_t now);
+  void publish_status_bits_(const StatusData &status_data);
+  void check_alarms_(const StatusData &status_data);
+  void publish_cell_trends_();
+  void publish_windows_();
+  void publish_energy_();
+  void publish_diagnostics_();
+#ifdef USE_KILOVAULT_DECODE_TIME
+  LatencyHistogram take_decode_time_();
+#endif
+  void save_energy_(bool force);
   void decode_protect_ic_data_(const std::vector<uint8_t> &data);
   void publish_state_(binary_sensor::BinarySensor *binary_sensor, const bool &state);
-  void publish_state_(sensor::Sensor *sensor, float value);
+  void publish_state_(sensor::Sensor *sensor, float value, bool bypass_filter = false);
   void publish_state_(text_sensor::TextSensor *text_sensor, const std::string &state);
   void publish_state_(switch_::Switch *obj, const bool &state);
   bool send_command_(uint8_t start_of_frame, uint8_t function, uint8_t value = 0x00);
+  void send_next_command_();
+  void retry_command_();
+  void finish_command_(bool success);
 
   uint16_t chksum_(const uint8_t data[], const uint16_t len) {
     uint16_t checksum = 0x00;
@@ -141,6 +604,17 @@ class KilovaultBmsBle : public esphome::ble_client::BLEClientNode, public Pollin
   }
 };
 
+/*
+  on_alarm: fires as soon as a frame breaks one of the limits, with the name of the
+  alarm and the offending value. It fires again only after the alarm cleared.
+*/
+class AlarmTrigger : public Trigger<std::string, float> {
+ public:
+  explicit AlarmTrigger(KilovaultBmsBle *parent) {
+    parent->add_on_alarm_callback([this](const std::string &alarm, float value) { this->trigger(alarm, value); });
+  }
+};
+
 }  // namespace kilovault_bms_ble
 }  // namespace esphome
 
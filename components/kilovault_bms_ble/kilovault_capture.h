@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace esphome {
+namespace kilovault_bms_ble {
+
+/*
+  Ring buffer of the most recent raw notifications, exactly as they came off the air.
+
+  Records are packed back to back into one fixed byte buffer, allocated once:
+
+    [timestamp: 4 bytes LE][length: 2 bytes LE][length bytes of notification]
+
+  Records may wrap around the end of the buffer. When a new record does not fit, the
+  oldest ones are evicted until it does, so the buffer always holds the newest traffic
+  and recording a notification never allocates.
+*/
+class CaptureBuffer {
+ public:
+  static constexpr size_t HEADER_SIZE = 6;
+
+  void allocate(size_t capacity) {
+    this->buffer_.assign(capacity, 0);
+    this->clear();
+  }
+
+  void clear() {
+    this->head_ = 0;
+    this->used_ = 0;
+    this->records_ = 0;
+  }
+
+  bool enabled() const { return !this->buffer_.empty(); }
+  size_t size() const { return this->records_; }
+  size_t used() const { return this->used_; }
+  size_t capacity() const { return this->buffer_.size(); }
+
+  void record(uint32_t timestamp, const uint8_t *data, uint16_t length) {
+    size_t record_size = HEADER_SIZE + length;
+    if (record_size > this->buffer_.size())
+      return;
+
+    while (this->buffer_.size() - this->used_ < record_size)
+      this->evict_();
+
+    uint8_t header[HEADER_SIZE] = {
+        uint8_t(timestamp), uint8_t(timestamp >> 8), uint8_t(timestamp >> 16), uint8_t(timestamp >> 24),
+        uint8_t(length),    uint8_t(length >> 8),
+    };
+    size_t tail = (this->head_ + this->used_) % this->buffer_.size();
+    tail = this->write_(tail, header, HEADER_SIZE);
+    this->write_(tail, data, length);
+    this->used_ += record_size;
+    this->records_++;
+  }
+
+  // Calls visit(timestamp, data, length) for every record, oldest first
+  template<typename F> void for_each(F &&visit) const {
+    std::vector<uint8_t> record;
+    size_t offset = this->head_;
+    for (size_t i = 0; i < this->records_; i++) {
+      uint8_t header[HEADER_SIZE];
+      offset = this->read_(offset, header, HEADER_SIZE);
+      uint32_t timestamp = header[0] | (header[1] << 8) | (header[2] << 16) | (uint32_t(header[3]) << 24);
+      uint16_t length = header[4] | (header[5] << 8);
+      record.resize(length);
+      offset = this->read_(offset, record.data(), length);
+      visit(timestamp, record.data(), length);
+    }
+  }
+
+ protected:
+  void evict_() {
+    uint8_t header[HEADER_SIZE];
+    this->read_(this->head_, header, HEADER_SIZE);
+    size_t record_size = HEADER_SIZE + (header[4] | (header[5] << 8));
+    this->head_ = (this->head_ + record_size) % this->buffer_.size();
+    this->used_ -= record_size;
+    this->records_--;
+  }
+
+  size_t write_(size_t offset, const uint8_t *data, size_t length) {
+    size_t first = std::min(length, this->buffer_.size() - offset);
+    memcpy(&this->buffer_[offset], data, first);
+    memcpy(&this->buffer_[0], data + first, length - first);
+    return (offset + length) % this->buffer_.size();
+  }
+
+  size_t read_(size_t offset, uint8_t *data, size_t length) const {
+    size_t first = std::min(length, this->buffer_.size() - offset);
+    memcpy(data, &this->buffer_[offset], first);
+    memcpy(data + first, &this->buffer_[0], length - first);
+    return (offset + length) % this->buffer_.size();
+  }
+
+  std::vector<uint8_t> buffer_;
+  size_t head_{0};
+  size_t used_{0};
+  size_t records_{0};
+};
+
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/*
+  Kilovault frame protocol.
+
+  Everything in here only depends on the standard library, so the framing, conversion
+  and checksum code can be compiled and exercised without an ESP32 or the ESP-IDF headers.
+  KilovaultBmsBle uses these helpers from the BLE callback.
+
+  Frame layout (MAX_RESPONSE_SIZE bytes):
+    [0]        Preamble (0xB0), never a valid ASCII-hex character
+    [1..120]   ASCII-hex payload, two characters per byte, high nibble first
+  The payload decodes to KILOVAULT_PAYLOAD_SIZE bytes. The checksum is the 16 bit sum of
+  the first KILOVAULT_CHECKSUM_SIZE payload bytes, stored big endian right behind them.
+*/
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The SWAR hex decoder assumes a little endian target"
+#endif
+
+namespace esphome {
+namespace kilovault_bms_ble {
+
+static const uint16_t MAX_RESPONSE_SIZE = 121;
+
+// Longest notification accepted. An ATT attribute value can not be longer than this,
+// so anything bigger is corrupt.
+static const uint16_t MAX_NOTIFY_SIZE = 512;
+
+static const uint8_t KILOVAULT_PKT_START_A = 0xB0;
+static const uint8_t KILOVAULT_PKT_START_B = 0xB0;
+
+// Number of cells in the pack, set by code generation from the cell_count option. The
+// cell voltages follow each other in the payload, up to 16 of them fit in front of the
+// checksum, which CellVoltages checks at compile time.
+#ifndef KILOVAULT_CELL_COUNT
+#define KILOVAULT_CELL_COUNT 4
+#endif
+static constexpr uint8_t CELL_COUNT = KILOVAULT_CELL_COUNT;
+
+// Decoded payload size, and the number of payload bytes covered by the checksum.
+static const uint8_t KILOVAULT_PAYLOAD_SIZE = (MAX_RESPONSE_SIZE - 1) / 2;
+static const uint8_t KILOVAULT_CHECKSUM_SIZE = 54;
+
+inline bool is_preamble(uint8_t c) { return c == KILOVAULT_PKT_START_A || c == KILOVAULT_PKT_START_B; }
+
+/*
+  Scalar reference decoder.
+
+  Converts one ASCII-hex character to its nibble value, or 0xFF if it is not a hex
+  character.
+*/
+inline uint8_t hex_to_nibble(uint8_t c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return 0xFF;
+}
+
+/*
+  Converts len bytes worth of ASCII-hex characters (2 * len characters) from src into dst
+  and adds every decoded byte to sum. Returns false if any character is not a hex character.
+*/
+inline bool hex_decode_scalar(const uint8_t *src, size_t len, uint8_t *dst, uint16_t &sum) {
+  bool valid = true;
+  for (size_t i = 0; i < len; i++) {
+    uint8_t hi = hex_to_nibble(src[2 * i]);
+    uint8_t lo = hex_to_nibble(src[2 * i + 1]);
+    valid &= hi != 0xFF && lo != 0xFF;
+    dst[i] = (hi << 4) | (lo & 0x0F);
+    sum += dst[i];
+  }
+  return valid;
+}
+
+/*
+  SWAR decoder, four characters (two bytes) per 32 bit word, without any data dependent
+  branches.
+
+  For a hex character c the nibble is (c & 0x0F), plus 9 if bit 6 is set ('A'-'F' and
+  'a'-'f'). Validity uses the "has byte between" trick, which sets the top bit of every
+  byte in range without carries crossing into the neighbouring byte. Letters are checked
+  after folding to lower case with | 0x20, which only maps 'A'-'F' onto 'a'-'f'.
+*/
+static const uint32_t SWAR_ONES = 0x01010101;
+static const uint32_t SWAR_HIGH = 0x80808080;
+
+constexpr uint32_t swar_between(uint32_t x, uint8_t m, uint8_t n) {
+  // Top bit set in every byte with m < byte < n, for 0 <= m <= 127 and 0 <= n <= 128.
+  return ((SWAR_ONES * (127 + n) - (x & SWAR_ONES * 127)) & ~x & ((x & SWAR_ONES * 127) + SWAR_ONES * (127 - m))) &
+         SWAR_HIGH;
+}
+
+constexpr uint32_t swar_hex_valid(uint32_t x) {
+  return swar_between(x, '0' - 1, '9' + 1) | swar_between(x | 0x20202020, 'a' - 1, 'f' + 1);
+}
+
+/*
+  Same contract as hex_decode_scalar(), len must be even. The decoded bytes are summed in
+  two 16 bit lanes and folded at the end, which holds for up to 257 words.
+*/
+inline bool hex_decode_swar(const uint8_t *src, size_t len, uint8_t *dst, uint16_t &sum) {
+  uint32_t invalid = 0;
+  uint32_t lanes = 0;
+  for (size_t i = 0; i < len; i += 2) {
+    uint32_t x;
+    __builtin_memcpy(&x, src + 2 * i, sizeof(x));
+
+    invalid |= swar_hex_valid(x) ^ SWAR_HIGH;
+
+    uint32_t nibbles = (x & 0x0F0F0F0F) + ((x >> 6) & SWAR_ONES) * 9;
+    // Byte 0 becomes (n0 << 4) | n1, byte 2 becomes (n2 << 4) | n3
+    uint32_t packed = ((nibbles << 4) | (nibbles >> 8)) & 0x00FF00FF;
+    dst[i + 0] = packed;
+    dst[i + 1] = packed >> 16;
+    lanes += packed;
+  }
+  sum += (lanes & 0xFFFF) + (lanes >> 16);
+  return invalid == 0;
+}
+
+// Checksum transmitted with a decoded payload.
+inline uint16_t frame_remote_checksum(const uint8_t *payload) {
+  return (uint16_t(payload[KILOVAULT_CHECKSUM_SIZE]) << 8) | payload[KILOVAULT_CHECKSUM_SIZE + 1];
+}
+
+/*
+  Raw values of a status frame, in the units the BMS sends them.
+*/
+struct StatusData {
+  uint16_t voltage;           // mV
+  int32_t current;            // mA, negative while discharging
+  uint32_t total_capacity;    // mAh
+  uint16_t cycles;
+  uint16_t state_of_charge;   // %
+  int16_t temperature;        // 0.1 K
+  int16_t status;
+  uint16_t afe_status;
+  uint16_t cell_voltages[CELL_COUNT];  // mV
+};
+
+/*
+  Values derived from a status frame, in exact integer units. Everything up to the
+  publish works on these, floats only come in when a value leaves the component.
+*/
+
+// mW, voltage (mV) times current (mA). 16 by 32 bits, so it is kept in 64.
+inline int64_t frame_power_mw(const StatusData &data) { return int64_t(data.voltage) * data.current / 1000; }
+
+// mAh left, total capacity (mAh) times state of charge (%)
+inline uint32_t frame_remaining_capacity_mah(const StatusData &data) {
+  return uint64_t(data.total_capacity) * data.state_of_charge / 100;
+}
+
+// 0.01 °C, the BMS sends 0.1 K and 273.15 K is not a whole number of those
+inline int32_t frame_temperature_centi_celsius(const StatusData &data) {
+  return int32_t(data.temperature) * 10 - 27315;
+}
+
+// Lowest and highest cell voltage (mV) and their cells, numbered from 1. Cells reading
+// 0 are not connected and left out of the minimum, min_cell is 0 when all of them are.
+struct CellVoltageRange {
+  uint16_t min{UINT16_MAX};
+  uint16_t max{0};
+  uint8_t min_cell{0};
+  uint8_t max_cell{1};
+};
+
+inline CellVoltageRange frame_cell_voltage_range(const StatusData &data) {
+  CellVoltageRange range;
+  range.max = data.cell_voltages[0];
+  for (uint8_t i = 0; i < CELL_COUNT; i++) {
+    uint16_t cell_voltage = data.cell_voltages[i];
+    if (cell_voltage > 0 && cell_voltage < range.min) {
+      range.min = cell_voltage;
+      range.min_cell = i + 1;
+    }
+    if (cell_voltage > range.max) {
+      range.max = cell_voltage;
+      range.max_cell = i + 1;
+    }
+  }
+  return range;
+}
+
+// 10^exp as a compile time constant, used for the field scale factors.
+constexpr float pow10f(int exp) { return exp == 0 ? 1.0f : exp > 0 ? 10.0f * pow10f(exp - 1) : 0.1f * pow10f(exp + 1); }
+
+// Reads a 16 bit little endian value from a decoded payload.
+inline uint16_t get_16bit(const uint8_t *payload, size_t i) {
+  return (uint16_t(payload[i + 1]) << 8) | (uint16_t(payload[i + 0]) << 0);
+}
+
+// Two 16 bit values, low word first.
+inline uint32_t get_32bit(const uint8_t *payload, size_t i) {
+  return (uint32_t(get_16bit(payload, i + 2)) << 16) | (uint32_t(get_16bit(payload, i + 0)) << 0);
+}
+
+/*
+  A single field of a status frame.
+    Offset:   character offset of the field inside the frame, as in the protocol notes
+    Width:    16 or 32 bits
+    Signed:   two's complement value
+    Exponent: scale factor to the published unit as a power of ten (-3 turns mV into V)
+    Member:   StatusData member the raw value is stored in
+  INDEX is the matching byte index into the decoded payload.
+*/
+template<uint8_t Offset, uint8_t Width, bool Signed, int Exponent, auto Member> struct FrameField {
+  static_assert(Width == 16 || Width == 32, "Fields are 16 or 32 bit wide");
+  static_assert(Offset % 2 == 1, "Fields start on a byte boundary of the payload");
+  static_assert((Offset - 1) / 2 + Width / 8 <= KILOVAULT_CHECKSUM_SIZE, "Field outside of the checksummed payload");
+
+  using unsigned_type = typename std::conditional<Width == 16, uint16_t, uint32_t>::type;
+  using raw_type = typename std::conditional<Signed, typename std::make_signed<unsigned_type>::type, unsigned_type>::type;
+
+  static constexpr uint8_t OFFSET = Offset;
+  static constexpr uint8_t INDEX = (Offset - 1) / 2;
+  static constexpr float SCALE = pow10f(Exponent);
+
+  static raw_type read(const uint8_t *payload) {
+    if (Width == 16)
+      return static_cast<raw_type>(get_16bit(payload, INDEX));
+    return static_cast<raw_type>(get_32bit(payload, INDEX));
+  }
+
+  static constexpr uint8_t END = INDEX + Width / 8;
+
+  // Decodes the field if its last byte is in the payload range [from, to).
+  static void decode_range(const uint8_t *payload, StatusData &data, uint8_t from, uint8_t to) {
+    if (END > from && END <= to)
+      data.*Member = read(payload);
+  }
+
+  static float to_float(raw_type value) { return value * SCALE; }
+};
+
+/*
+  Count consecutive 16 bit values, Stride characters apart, stored in a StatusData array.
+*/
+template<uint8_t Offset, uint8_t Count, uint8_t Stride, int Exponent, auto Member> struct FrameArray {
+  static_assert(Offset % 2 == 1 && Stride % 2 == 0, "Fields start on a byte boundary of the payload");
+  static_assert((Offset - 1) / 2 + (Count - 1) * Stride / 2 + 2 <= KILOVAULT_CHECKSUM_SIZE,
+                "Field outside of the checksummed payload");
+
+  static constexpr uint8_t INDEX = (Offset - 1) / 2;
+  static constexpr float SCALE = pow10f(Exponent);
+
+  // Decodes the values whose last byte is in the payload range [from, to).
+  static void decode_range(const uint8_t *payload, StatusData &data, uint8_t from, uint8_t to) {
+    for (uint8_t i = 0; i < Count; i++) {
+      uint8_t end = INDEX + i * Stride / 2 + 2;
+      if (end > from && end <= to)
+        (data.*Member)[i] = get_16bit(payload, end - 2);
+    }
+  }
+
+  static float to_float(uint16_t value) { return value * SCALE; }
+};
+
+/*
+  A complete frame layout. decode_range() expands into one check and read per field, in
+  field order, without any runtime table walk. FrameDecoder is the only user, it calls
+  it as the payload grows, so every field is read exactly once per frame.
+*/
+template<typename... Fields> struct FrameLayout {
+  // Decodes the fields that became complete when the payload grew from `from` to `to` bytes.
+  static void decode_range(const uint8_t *payload, StatusData &data, uint8_t from, uint8_t to) {
+    (Fields::decode_range(payload, data, from, to), ...);
+  }
+};
+
+/*
+  Layout of the status frame sent by the current BMS firmware. A firmware with a
+  different layout gets its own namespace and Layout alias.
+*/
+namespace layout_v1 {
+using Voltage = FrameField<1, 16, false, -3, &StatusData::voltage>;
+using Current = FrameField<9, 32, true, -3, &StatusData::current>;
+using TotalCapacity = FrameField<17, 32, false, -3, &StatusData::total_capacity>;
+using Cycles = FrameField<25, 16, false, 0, &StatusData::cycles>;
+using StateOfCharge = FrameField<29, 16, false, 0, &StatusData::state_of_charge>;
+using Temperature = FrameField<33, 16, true, -1, &StatusData::temperature>;
+using Status = FrameField<37, 16, true, 0, &StatusData::status>;
+using AfeStatus = FrameField<41, 16, false, 0, &StatusData::afe_status>;
+using CellVoltages = FrameArray<45, CELL_COUNT, 4, -3, &StatusData::cell_voltages>;
+
+using Layout =
+    FrameLayout<Voltage, Current, TotalCapacity, Cycles, StateOfCharge, Temperature, Status, AfeStatus, CellVoltages>;
+}  // namespace layout_v1
+
+/*
+  Incremental frame decoder.
+
+  advance() is called every time more characters of the current frame have arrived. It
+  converts every newly completed word, adds it to the running checksum and pulls out
+  every field that is now complete. By the time the last notification of a frame lands
+  only its final word is left, so finishing a frame costs a compare of the checksums.
+*/
+template<typename Layout> class FrameDecoder {
+ public:
+  void reset() {
+    this->decoded_ = 0;
+    this->checksum_ = 0;
+    this->valid_ = true;
+  }
+
+  // frame points to the preamble, length counts every character received so far.
+  void advance(const uint8_t *frame, size_t length) {
+    // Only whole words are decoded, a word is four characters
+    uint8_t target = length > 1 ? ((length - 1) / 4) * 2 : 0;
+    if (target > KILOVAULT_PAYLOAD_SIZE)
+      target = KILOVAULT_PAYLOAD_SIZE;
+    if (target <= this->decoded_)
+      return;
+
+    uint8_t from = this->decoded_;
+    if (this->decoded_ < KILOVAULT_CHECKSUM_SIZE) {
+      uint8_t n = std::min<uint8_t>(target, KILOVAULT_CHECKSUM_SIZE) - this->decoded_;
+      this->valid_ &= hex_decode_swar(frame + 1 + 2 * this->decoded_, n, this->payload_ + this->decoded_, this->checksum_);
+      this->decoded_ += n;
+    }
+    if (target > this->decoded_) {
+      uint16_t unused = 0;
+      uint8_t n = target - this->decoded_;
+      this->valid_ &= hex_decode_swar(frame + 1 + 2 * this->decoded_, n, this->payload_ + this->decoded_, unused);
+      this->decoded_ += n;
+    }
+
+    Layout::decode_range(this->payload_, this->data_, from, this->decoded_);
+  }
+
+  bool complete() const { return this->decoded_ == KILOVAULT_PAYLOAD_SIZE; }
+  // False once a non-hex character has been seen
+  bool valid() const { return this->valid_; }
+  bool checksum_ok() const { return this->checksum_ == this->remote_checksum(); }
+  uint16_t checksum() const { return this->checksum_; }
+  uint16_t remote_checksum() const { return frame_remote_checksum(this->payload_); }
+  const uint8_t *payload() const { return this->payload_; }
+  const StatusData &data() const { return this->data_; }
+
+ protected:
+  uint8_t payload_[KILOVAULT_PAYLOAD_SIZE];
+  StatusData data_{};
+  uint8_t decoded_{0};
+  uint16_t checksum_{0};
+  bool valid_{true};
+};
+
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace esphome {
+namespace kilovault_bms_ble {
+
+/*
+  Lock-free single producer, single consumer ring of raw notifications, for handing
+  them from the BLE callback to the decode task.
+
+  Records are packed back to back into one byte buffer, allocated once:
+
+    [length: 2 bytes LE][length bytes of notification]
+
+  The producer only writes head_, the consumer only writes tail_. Both are free running
+  counters, their difference is the number of bytes in use. The capacity is a power of
+  two, so it divides 2^32 and masking a counter gives the same position before and
+  after the counter wraps. A record that does not fit
+  is dropped and counted, the producer never waits. The next record that fits is then
+  preceded by an empty one, which tells the consumer that data is missing in between.
+*/
+class SpscRing {
+ public:
+  static constexpr size_t HEADER_SIZE = 2;
+
+  // Rounds capacity up to a power of two
+  void allocate(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    this->buffer_.assign(size, 0);
+    this->mask_ = size - 1;
+  }
+  size_t capacity() const { return this->buffer_.size(); }
+
+  // Producer side. Returns false, and counts an overflow, when the record did not fit.
+  bool push(const uint8_t *data, uint16_t length) {
+    uint32_t head = this->head_.load(std::memory_order_relaxed);
+    uint32_t tail = this->tail_.load(std::memory_order_acquire);
+    size_t needed = HEADER_SIZE + length + (this->lost_ ? HEADER_SIZE : 0);
+    if (this->buffer_.size() - (head - tail) < needed) {
+      this->lost_ = true;
+      this->overflows_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    if (this->lost_) {
+      head = this->write_record_(head, nullptr, 0);
+      this->lost_ = false;
+    }
+    head = this->write_record_(head, data, length);
+    this->head_.store(head, std::memory_order_release);
+    return true;
+  }
+
+  // Producer side. Queues an empty record, so the consumer drops its partial frame.
+  void push_gap() { this->push(nullptr, 0); }
+
+  /*
+    Consumer side. Copies the oldest record into data, which must hold the largest
+    record ever pushed, and returns its length. Returns -1 when the ring is empty and 0
+    for a gap.
+  */
+  int pop(uint8_t *data) {
+    uint32_t tail = this->tail_.load(std::memory_order_relaxed);
+    uint32_t head = this->head_.load(std::memory_order_acquire);
+    if (head == tail)
+      return -1;
+
+    uint8_t header[HEADER_SIZE];
+    tail = this->read_(tail, header, HEADER_SIZE);
+    uint16_t length = header[0] | (header[1] << 8);
+    tail = this->read_(tail, data, length);
+    this->tail_.store(tail, std::memory_order_release);
+    return length;
+  }
+
+  uint32_t overflows() const { return this->overflows_.load(std::memory_order_relaxed); }
+
+ protected:
+  uint32_t write_record_(uint32_t head, const uint8_t *data, uint16_t length) {
+    uint8_t header[HEADER_SIZE] = {uint8_t(length), uint8_t(length >> 8)};
+    head = this->write_(head, header, HEADER_SIZE);
+    if (length == 0)
+      return head;
+    return this->write_(head, data, length);
+  }
+
+  uint32_t write_(uint32_t position, const uint8_t *data, size_t length) {
+    size_t offset = position & this->mask_;
+    size_t first = std::min(length, this->buffer_.size() - offset);
+    memcpy(&this->buffer_[offset], data, first);
+    memcpy(&this->buffer_[0], data + first, length - first);
+    return position + length;
+  }
+
+  uint32_t read_(uint32_t position, uint8_t *data, size_t length) const {
+    if (length == 0)
+      return position;
+    size_t offset = position & this->mask_;
+    size_t first = std::min(length, this->buffer_.size() - offset);
+    memcpy(data, &this->buffer_[offset], first);
+    memcpy(data + first, &this->buffer_[0], length - first);
+    return position + length;
+  }
+
+  std::vector<uint8_t> buffer_;
+  uint32_t mask_{0};
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> overflows_{0};
+  bool lost_{false};  // producer only
+};
+
+/*
+  Single writer seqlock around a trivially copyable value.
+
+  The writer bumps the sequence to odd, copies the value and bumps it to even again.
+  A reader copies the value between two reads of the sequence and retries when the
+  sequence was odd or changed, so it never sees a half written value and the writer
+  never waits for the reader.
+*/
+template<typename T> class Seqlock {
+ public:
+  void write(const T &value) {
+    uint32_t sequence = this->sequence_.load(std::memory_order_relaxed);
+    this->sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&this->value_, &value, sizeof(T));
+    this->sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Copies the latest value and returns its sequence, 0 when nothing was written yet
+  uint32_t read(T &value) const {
+    uint32_t before, after;
+    do {
+      before = this->sequence_.load(std::memory_order_acquire);
+      memcpy(&value, &this->value_, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = this->sequence_.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return before;
+  }
+
+ protected:
+  std::atomic<uint32_t> sequence_{0};
+  T value_{};
+};
+
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
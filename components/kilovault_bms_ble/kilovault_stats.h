@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace kilovault_bms_ble {
+
+/*
+  Streaming statistics over one publish window.
+
+  add() is O(1) and keeps no samples: min and max are tracked directly, mean and
+  variance use Welford's update. The RMS follows from both, since the mean square
+  equals the variance plus the squared mean.
+*/
+struct WindowStats {
+  uint32_t count{0};
+  float mean{0.0f};
+  float m2{0.0f};
+  float min{NAN};
+  float max{NAN};
+
+  void add(float value) {
+    if (this->count == 0 || value < this->min)
+      this->min = value;
+    if (this->count == 0 || value > this->max)
+      this->max = value;
+
+    this->count++;
+    float delta = value - this->mean;
+    this->mean += delta / this->count;
+    this->m2 += delta * (value - this->mean);
+  }
+
+  void reset() { *this = WindowStats{}; }
+
+  float variance() const { return this->count > 0 ? this->m2 / this->count : NAN; }
+  float rms() const { return this->count > 0 ? std::sqrt(this->variance() + this->mean * this->mean) : NAN; }
+};
+
+/*
+  Fixed bucket latency histogram for the hot path.
+
+  Bucket i counts samples below 2^i us, the last bucket everything above. add() is a
+  count-leading-zeros and an increment, percentiles are read back as the upper bound
+  of the bucket they fall in, which is within a factor of two of the real value.
+*/
+struct LatencyHistogram {
+  static constexpr uint8_t BUCKETS = 16;
+
+  uint32_t buckets[BUCKETS]{};
+  uint32_t count{0};
+  uint32_t max{0};
+
+  void add(uint32_t us) {
+    uint8_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    this->buckets[bucket < BUCKETS ? bucket : BUCKETS - 1]++;
+    this->count++;
+    if (us > this->max)
+      this->max = us;
+  }
+
+  void reset() { *this = LatencyHistogram{}; }
+
+  // Upper bound in us of the bucket holding the given fraction of the samples, NAN when empty
+  float percentile(float fraction) const {
+    if (this->count == 0)
+      return NAN;
+    uint32_t rank = uint32_t(std::ceil(fraction * this->count));
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < BUCKETS - 1; i++) {
+      seen += this->buckets[i];
+      if (seen >= rank)
+        return std::min<float>(1u << i, this->max);
+    }
+    return this->max;
+  }
+};
+
+/*
+  Online estimate of the internal resistance of one cell.
+
+  Across a current step the cell voltage moves by dV = R * dI, on top of the slow drift
+  of the state of charge. Fitting the (dI, dV) samples through the origin by least
+  squares gives R = sum(dI * dV) / sum(dI^2). Both sums are scaled by the forgetting
+  factor before every sample, so old samples fade out and the estimate follows the
+  aging of the cell. Two sums per cell, O(1) per sample.
+*/
+struct ResistanceEstimator {
+  float sum_xy{0.0f};
+  float sum_xx{0.0f};
+  uint32_t count{0};
+
+  // Current step in A, voltage step in V
+  void add(float current_step, float voltage_step, float forgetting) {
+    this->sum_xy = forgetting * this->sum_xy + current_step * voltage_step;
+    this->sum_xx = forgetting * this->sum_xx + current_step * current_step;
+    this->count++;
+  }
+
+  // Ohm, NAN without samples
+  float resistance() const { return this->sum_xx > 0.0f ? this->sum_xy / this->sum_xx : NAN; }
+};
+
+/*
+  Exponentially weighted moving average. The weight is passed per sample, so it can
+  follow the time between irregular samples. The first sample is taken as is.
+*/
+struct Ewma {
+  float value{NAN};
+
+  void add(float sample, float weight) {
+    this->value = std::isnan(this->value) ? sample : this->value + weight * (sample - this->value);
+  }
+};
+
+/*
+  Charge and energy totals, split by direction. The values are kept as twice the
+  integral (trapezoid areas without the halving) in mA*ms and mW*ms, so every update
+  stays in exact 64 bit integer math.
+*/
+struct EnergyTotals {
+  int64_t charge_in{0};
+  int64_t charge_out{0};
+  int64_t energy_in{0};
+  int64_t energy_out{0};
+};
+
+/*
+  Integrates current and power over the frame timestamps with the trapezoidal rule.
+
+  When a segment crosses zero it is split at the crossing, so charging and discharging
+  each only get their own part of the area. Gaps longer than max_gap (lost frames,
+  reconnects) are not integrated, the next sample starts a new segment instead.
+
+  A frame carries at most 65535 mV * 2^31 mA, about 1.4e11 mW. With the gap capped at
+  MAX_GAP_LIMIT every segment stays below 2^63.
+*/
+class EnergyIntegrator {
+ public:
+  // Twice the integral in mA*ms or mW*ms, per Ah or Wh
+  static constexpr double UNITS_PER_HOUR = 2.0 * 1000.0 * 3600.0 * 1000.0;
+  static constexpr uint32_t MAX_GAP_LIMIT = 3600000;
+
+  void add(uint32_t timestamp, int32_t current, int64_t power) {
+    if (this->has_sample_) {
+      uint32_t dt = timestamp - this->last_timestamp_;
+      if (dt <= this->max_gap_) {
+        integrate_(this->last_current_, current, dt, this->totals.charge_in, this->totals.charge_out);
+        integrate_(this->last_power_, power, dt, this->totals.energy_in, this->totals.energy_out);
+      }
+    }
+    this->has_sample_ = true;
+    this->last_timestamp_ = timestamp;
+    this->last_current_ = current;
+    this->last_power_ = power;
+  }
+
+  // Forget the last sample, the next one does not integrate back to it
+  void restart() { this->has_sample_ = false; }
+
+  void set_max_gap(uint32_t max_gap) { this->max_gap_ = std::min(max_gap, MAX_GAP_LIMIT); }
+  uint32_t get_max_gap() const { return this->max_gap_; }
+
+  static float to_hours(int64_t total) { return total / UNITS_PER_HOUR; }
+
+  EnergyTotals totals;
+
+ protected:
+  static void integrate_(int64_t a, int64_t b, uint32_t dt, int64_t &positive, int64_t &negative) {
+    if (a >= 0 && b >= 0) {
+      positive += (a + b) * dt;
+    } else if (a <= 0 && b <= 0) {
+      negative -= (a + b) * dt;
+    } else {
+      // Split at the zero crossing, each side is a triangle of height |a| or |b|. The
+      // square of a height can pass 2^63, the share of dt is taken in double instead.
+      int64_t abs_a = a < 0 ? -a : a;
+      int64_t abs_b = b < 0 ? -b : b;
+      double dt_per_height = double(dt) / double(abs_a + abs_b);
+      int64_t area_a = llround(double(abs_a) * abs_a * dt_per_height);
+      int64_t area_b = llround(double(abs_b) * abs_b * dt_per_height);
+      (a > 0 ? positive : negative) += area_a;
+      (b > 0 ? positive : negative) += area_b;
+    }
+  }
+
+  uint32_t max_gap_{60000};
+  bool has_sample_{false};
+  uint32_t last_timestamp_{0};
+  int32_t last_current_{0};
+  int64_t last_power_{0};
+};
+
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -1,25 +1,33 @@
 import esphome.codegen as cg
 from esphome.components import sensor
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 from esphome.const import (
     CONF_CURRENT,
     CONF_POWER,
     DEVICE_CLASS_CURRENT,
     DEVICE_CLASS_EMPTY,
+    DEVICE_CLASS_ENERGY,
     DEVICE_CLASS_POWER,
     DEVICE_CLASS_TEMPERATURE,
     DEVICE_CLASS_VOLTAGE,
+    ENTITY_CATEGORY_DIAGNOSTIC,
     ICON_EMPTY,
     STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
     UNIT_AMPERE,
     UNIT_CELSIUS,
     UNIT_EMPTY,
+    UNIT_HERTZ,
+    UNIT_MILLISECOND,
     UNIT_PERCENT,
+    UNIT_SECOND,
     UNIT_VOLT,
     UNIT_WATT,
+    UNIT_WATT_HOURS,
 )
 
-from . import CONF_KILOVAULT_BMS_BLE_ID, KilovaultBmsBle
+from . import CONF_CELL_COUNT, CONF_KILOVAULT_BMS_BLE_ID, MAX_CELLS, KilovaultBmsBle
 
 DEPENDENCIES = ["kilovault_bms_ble"]
 
@@ -42,12 +50,33 @@ CONF_MIN_VOLTAGE_CELL = "min_voltage_cell"
 CONF_MAX_VOLTAGE_CELL = "max_voltage_cell"
 CONF_DELTA_CELL_VOLTAGE = "delta_cell_voltage"
 
-CONF_CELL_VOLTAGE_1 = "cell_voltage_1"
-CONF_CELL_VOLTAGE_2 = "cell_voltage_2"
-CONF_CELL_VOLTAGE_3 = "cell_voltage_3"
-CONF_CELL_VOLTAGE_4 = "cell_voltage_4"
 
 CONF_TEMPERATURE = "temperature"
+CONF_PUBLISH_SUPPRESSION = "publish_suppression"
+
+CONF_CHARGED_CAPACITY = "charged_capacity"
+CONF_DISCHARGED_CAPACITY = "discharged_capacity"
+CONF_CHARGED_ENERGY = "charged_energy"
+CONF_DISCHARGED_ENERGY = "discharged_energy"
+
+CONF_TIME_TO_FIRST_FRAME = "time_to_first_frame"
+CONF_STALENESS = "staleness"
+CONF_CYCLE_TIME = "cycle_time"
+
+CONF_NOTIFICATION_RATE = "notification_rate"
+CONF_FRAME_RATE = "frame_rate"
+CONF_CRC_FAILURES = "crc_failures"
+CONF_OVERSIZE_DROPS = "oversize_drops"
+CONF_RESYNCS = "resyncs"
+CONF_EMPTY_FRAMES = "empty_frames"
+CONF_PUBLISH_LATENCY = "publish_latency"
+CONF_DECODE_TIME_P50 = "decode_time_p50"
+CONF_DECODE_TIME_P95 = "decode_time_p95"
+CONF_DECODE_TIME_P99 = "decode_time_p99"
+CONF_QUEUE_OVERFLOWS = "queue_overflows"
+CONF_FRAME_OVERRUNS = "frame_overruns"
+CONF_NEGOTIATED_MTU = "negotiated_mtu"
+CONF_CHUNKS_PER_FRAME = "chunks_per_frame"
 
 ICON_CURRENT_DC = "mdi:current-dc"
 ICON_STATE_OF_CHARGE = "mdi:battery-50"
@@ -57,15 +86,70 @@ ICON_MIN_CELL_VOLTAGE = "mdi:battery-minus-outline"
 ICON_MAX_CELL_VOLTAGE = "mdi:battery-plus-outline"
 ICON_MIN_VOLTAGE_CELL = "mdi:battery-minus-outline"
 ICON_MAX_VOLTAGE_CELL = "mdi:battery-plus-outline"
+ICON_TIME_TO_FIRST_FRAME = "mdi:timer-outline"
+ICON_STALENESS = "mdi:timer-sand"
+ICON_CYCLE_TIME = "mdi:timer-sync-outline"
 
 UNIT_AMPERE_HOURS = "Ah"
+UNIT_MICROSECOND = "µs"
+UNIT_MILLIOHM = "mΩ"
+UNIT_MILLIVOLT = "mV"
 
-CELLS = [
-    CONF_CELL_VOLTAGE_1,
-    CONF_CELL_VOLTAGE_2,
-    CONF_CELL_VOLTAGE_3,
-    CONF_CELL_VOLTAGE_4,
-]
+ICON_CELL_RESISTANCE = "mdi:omega"
+ICON_CELL_DEVIATION = "mdi:scale-unbalanced"
+
+CONF_DEADBAND = "deadband"
+CONF_RELATIVE_DEADBAND = "relative_deadband"
+CONF_HEARTBEAT = "heartbeat"
+
+# Per-sensor publish filter. A value is only published when it moved by more than the
+# deadband, or when the heartbeat interval passed since the last publish.
+PUBLISH_FILTER_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_DEADBAND): cv.positive_float,
+        cv.Optional(CONF_RELATIVE_DEADBAND): cv.percentage,
+        cv.Optional(CONF_HEARTBEAT): cv.positive_time_period_milliseconds,
+    }
+)
+
+# cell_voltage_1 .. cell_voltage_16, only the first cell_count of them can be used
+CELLS = [f"cell_voltage_{i}" for i in range(1, MAX_CELLS + 1)]
+
+# Per-cell trends: the internal resistance estimated from the voltage response to
+# current steps, and the slow average offset of the cell from the pack mean.
+CELL_RESISTANCES = [f"cell_resistance_{i}" for i in range(1, MAX_CELLS + 1)]
+CELL_DEVIATIONS = [f"cell_deviation_{i}" for i in range(1, MAX_CELLS + 1)]
+
+# Windowed statistics, published once per update interval over every frame received
+# in between. The order matches the WindowChannel and WindowStatistic enums.
+WINDOW_CHANNELS = {
+    CONF_VOLTAGE: (UNIT_VOLT, ICON_EMPTY, DEVICE_CLASS_VOLTAGE),
+    CONF_CURRENT: (UNIT_AMPERE, ICON_CURRENT_DC, DEVICE_CLASS_CURRENT),
+    CONF_POWER: (UNIT_WATT, ICON_EMPTY, DEVICE_CLASS_POWER),
+    **{cell: (UNIT_VOLT, ICON_EMPTY, DEVICE_CLASS_VOLTAGE) for cell in CELLS},
+}
+
+WINDOW_STATISTICS = ["min", "max", "mean", "rms"]
+
+# Hot path diagnostics, published every update interval.
+DIAGNOSTICS = {
+    CONF_NOTIFICATION_RATE: (UNIT_HERTZ, "mdi:access-point", 1, STATE_CLASS_MEASUREMENT),
+    CONF_FRAME_RATE: (UNIT_HERTZ, "mdi:access-point", 2, STATE_CLASS_MEASUREMENT),
+    CONF_CRC_FAILURES: (UNIT_EMPTY, "mdi:alert-circle-outline", 0, STATE_CLASS_TOTAL_INCREASING),
+    CONF_OVERSIZE_DROPS: (UNIT_EMPTY, "mdi:alert-circle-outline", 0, STATE_CLASS_TOTAL_INCREASING),
+    CONF_RESYNCS: (UNIT_EMPTY, "mdi:sync-alert", 0, STATE_CLASS_TOTAL_INCREASING),
+    CONF_EMPTY_FRAMES: (UNIT_EMPTY, "mdi:battery-unknown", 0, STATE_CLASS_TOTAL_INCREASING),
+    CONF_PUBLISH_LATENCY: (UNIT_MILLISECOND, "mdi:timer-outline", 0, STATE_CLASS_MEASUREMENT),
+    CONF_DECODE_TIME_P50: (UNIT_MICROSECOND, "mdi:timer-outline", 0, STATE_CLASS_MEASUREMENT),
+    CONF_DECODE_TIME_P95: (UNIT_MICROSECOND, "mdi:timer-outline", 0, STATE_CLASS_MEASUREMENT),
+    CONF_DECODE_TIME_P99: (UNIT_MICROSECOND, "mdi:timer-outline", 0, STATE_CLASS_MEASUREMENT),
+    # Only with decode_task
+    CONF_QUEUE_OVERFLOWS: (UNIT_EMPTY, "mdi:tray-full", 0, STATE_CLASS_TOTAL_INCREASING),
+    CONF_FRAME_OVERRUNS: (UNIT_EMPTY, "mdi:debug-step-over", 0, STATE_CLASS_TOTAL_INCREASING),
+    # Notifications per frame drop to 1 once the MTU fits a whole frame
+    CONF_NEGOTIATED_MTU: (UNIT_EMPTY, "mdi:arrow-expand-horizontal", 0, STATE_CLASS_MEASUREMENT),
+    CONF_CHUNKS_PER_FRAME: (UNIT_EMPTY, "mdi:puzzle-outline", 2, STATE_CLASS_MEASUREMENT),
+}
 
 SENSORS = [
     CONF_VOLTAGE,
@@ -85,8 +169,49 @@ SENSORS = [
     CONF_MAX_VOLTAGE_CELL,
     CONF_DELTA_CELL_VOLTAGE,
     CONF_TEMPERATURE,
+    CONF_PUBLISH_SUPPRESSION,
+    CONF_CHARGED_CAPACITY,
+    CONF_DISCHARGED_CAPACITY,
+    CONF_CHARGED_ENERGY,
+    CONF_DISCHARGED_ENERGY,
+    CONF_TIME_TO_FIRST_FRAME,
+    CONF_STALENESS,
+    CONF_CYCLE_TIME,
+    *DIAGNOSTICS,
 ]
 
+# Feature flags, a configured sensor compiles in the code that decodes and publishes it
+# as USE_KILOVAULT_<flag>. Sensors that share that code share a flag, sensors missing
+# here publish values the hub keeps anyway and are always compiled in.
+FEATURES = {
+    CONF_VOLTAGE: "VOLTAGE",
+    CONF_CURRENT: "CURRENT",
+    CONF_POWER: "POWER",
+    CONF_CHARGING_POWER: "CHARGING_POWER",
+    CONF_DISCHARGING_POWER: "DISCHARGING_POWER",
+    CONF_CYCLES: "CYCLES",
+    CONF_STATE_OF_CHARGE: "STATE_OF_CHARGE",
+    CONF_TOTAL_CAPACITY: "TOTAL_CAPACITY",
+    CONF_CURRENT_CAPACITY: "CURRENT_CAPACITY",
+    CONF_STATUS: "STATUS",
+    CONF_AFESTATUS: "AFESTATUS",
+    CONF_TEMPERATURE: "TEMPERATURE",
+    CONF_MIN_CELL_VOLTAGE: "CELL_VOLTAGES",
+    CONF_MAX_CELL_VOLTAGE: "CELL_VOLTAGES",
+    CONF_MIN_VOLTAGE_CELL: "CELL_VOLTAGES",
+    CONF_MAX_VOLTAGE_CELL: "CELL_VOLTAGES",
+    CONF_DELTA_CELL_VOLTAGE: "CELL_VOLTAGES",
+    **{cell: "CELL_VOLTAGES" for cell in CELLS},
+    **{cell: "CELL_TRENDS" for cell in CELL_RESISTANCES + CELL_DEVIATIONS},
+    CONF_CHARGED_CAPACITY: "ENERGY",
+    CONF_DISCHARGED_CAPACITY: "ENERGY",
+    CONF_CHARGED_ENERGY: "ENERGY",
+    CONF_DISCHARGED_ENERGY: "ENERGY",
+    CONF_DECODE_TIME_P50: "DECODE_TIME",
+    CONF_DECODE_TIME_P95: "DECODE_TIME",
+    CONF_DECODE_TIME_P99: "DECODE_TIME",
+}
+
 # pylint: disable=too-many-function-args
 CONFIG_SCHEMA = cv.Schema(
     {
@@ -97,151 +222,291 @@ CONFIG_SCHEMA = cv.Schema(
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_CURRENT): sensor.sensor_schema(
             unit_of_measurement=UNIT_AMPERE,
             icon=ICON_CURRENT_DC,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_CURRENT,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_POWER): sensor.sensor_schema(
             unit_of_measurement=UNIT_WATT,
             icon=ICON_EMPTY,
             accuracy_decimals=2,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_CHARGING_POWER): sensor.sensor_schema(
             unit_of_measurement=UNIT_WATT,
             icon=ICON_EMPTY,
             accuracy_decimals=2,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_DISCHARGING_POWER): sensor.sensor_schema(
             unit_of_measurement=UNIT_WATT,
             icon=ICON_EMPTY,
             accuracy_decimals=2,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_CYCLES): sensor.sensor_schema(
             unit_of_measurement=UNIT_EMPTY,
             icon=ICON_EMPTY,
             accuracy_decimals=0,
             device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_STATE_OF_CHARGE): sensor.sensor_schema(
             unit_of_measurement=UNIT_PERCENT,
             icon=ICON_STATE_OF_CHARGE,
             accuracy_decimals=0,
             device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_TOTAL_CAPACITY): sensor.sensor_schema(
             unit_of_measurement=UNIT_AMPERE_HOURS,
             icon=ICON_TOTAL_CAPACITY,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_CURRENT_CAPACITY): sensor.sensor_schema(
             unit_of_measurement=UNIT_AMPERE_HOURS,
             icon=ICON_TOTAL_CAPACITY,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_STATUS): sensor.sensor_schema(
             unit_of_measurement=UNIT_EMPTY,
             icon=ICON_EMPTY,
             accuracy_decimals=0,
             device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_AFESTATUS): sensor.sensor_schema(
             unit_of_measurement=UNIT_EMPTY,
             icon=ICON_EMPTY,
             accuracy_decimals=0,
             device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_MIN_CELL_VOLTAGE): sensor.sensor_schema(
             unit_of_measurement=UNIT_VOLT,
             icon=ICON_MIN_CELL_VOLTAGE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_MAX_CELL_VOLTAGE): sensor.sensor_schema(
             unit_of_measurement=UNIT_VOLT,
             icon=ICON_MAX_CELL_VOLTAGE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_MIN_VOLTAGE_CELL): sensor.sensor_schema(
             unit_of_measurement=UNIT_EMPTY,
             icon=ICON_MIN_VOLTAGE_CELL,
             accuracy_decimals=0,
             device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_MAX_VOLTAGE_CELL): sensor.sensor_schema(
             unit_of_measurement=UNIT_EMPTY,
             icon=ICON_MAX_VOLTAGE_CELL,
             accuracy_decimals=0,
             device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_DELTA_CELL_VOLTAGE): sensor.sensor_schema(
             unit_of_measurement=UNIT_VOLT,
             icon=ICON_EMPTY,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA),
         cv.Optional(CONF_TEMPERATURE): sensor.sensor_schema(
             unit_of_measurement=UNIT_CELSIUS,
             icon=ICON_EMPTY,
             accuracy_decimals=0,
             device_class=DEVICE_CLASS_TEMPERATURE,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
-        cv.Optional(CONF_CELL_VOLTAGE_1): sensor.sensor_schema(
-            unit_of_measurement=UNIT_VOLT,
-            icon=ICON_EMPTY,
-            accuracy_decimals=3,
-            device_class=DEVICE_CLASS_VOLTAGE,
+        ).extend(PUBLISH_FILTER_SCHEMA),
+        # Share of the publishes in the last update interval held back by the publish filters
+        cv.Optional(CONF_PUBLISH_SUPPRESSION): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            icon="mdi:filter-outline",
+            accuracy_decimals=1,
             state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
         ),
-        cv.Optional(CONF_CELL_VOLTAGE_2): sensor.sensor_schema(
-            unit_of_measurement=UNIT_VOLT,
-            icon=ICON_EMPTY,
+        cv.Optional(CONF_CHARGED_CAPACITY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_AMPERE_HOURS,
+            icon=ICON_CURRENT_CAPACITY,
             accuracy_decimals=3,
-            device_class=DEVICE_CLASS_VOLTAGE,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+        ).extend(PUBLISH_FILTER_SCHEMA),
+        cv.Optional(CONF_DISCHARGED_CAPACITY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_AMPERE_HOURS,
+            icon=ICON_CURRENT_CAPACITY,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+        ).extend(PUBLISH_FILTER_SCHEMA),
+        cv.Optional(CONF_CHARGED_ENERGY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_WATT_HOURS,
+            icon=ICON_EMPTY,
+            accuracy_decimals=2,
+            device_class=DEVICE_CLASS_ENERGY,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+        ).extend(PUBLISH_FILTER_SCHEMA),
+        cv.Optional(CONF_DISCHARGED_ENERGY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_WATT_HOURS,
+            icon=ICON_EMPTY,
+            accuracy_decimals=2,
+            device_class=DEVICE_CLASS_ENERGY,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+        ).extend(PUBLISH_FILTER_SCHEMA),
+        cv.Optional(CONF_TIME_TO_FIRST_FRAME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon=ICON_TIME_TO_FIRST_FRAME,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_EMPTY,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
-        cv.Optional(CONF_CELL_VOLTAGE_3): sensor.sensor_schema(
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ).extend(PUBLISH_FILTER_SCHEMA),
+        cv.Optional(CONF_STALENESS): sensor.sensor_schema(
+            unit_of_measurement=UNIT_SECOND,
+            icon=ICON_STALENESS,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ).extend(PUBLISH_FILTER_SCHEMA),
+        cv.Optional(CONF_CYCLE_TIME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_SECOND,
+            icon=ICON_CYCLE_TIME,
+            accuracy_decimals=1,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ).extend(PUBLISH_FILTER_SCHEMA),
+    }
+)
+
+
+CONFIG_SCHEMA = CONFIG_SCHEMA.extend(
+    {
+        cv.Optional(key): sensor.sensor_schema(
             unit_of_measurement=UNIT_VOLT,
             icon=ICON_EMPTY,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
-        cv.Optional(CONF_CELL_VOLTAGE_4): sensor.sensor_schema(
-            unit_of_measurement=UNIT_VOLT,
-            icon=ICON_EMPTY,
+        ).extend(PUBLISH_FILTER_SCHEMA)
+        for key in CELLS
+    }
+)
+
+
+CONFIG_SCHEMA = CONFIG_SCHEMA.extend(
+    {
+        **{
+            cv.Optional(key): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLIOHM,
+                icon=ICON_CELL_RESISTANCE,
+                accuracy_decimals=2,
+                device_class=DEVICE_CLASS_EMPTY,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ).extend(PUBLISH_FILTER_SCHEMA)
+            for key in CELL_RESISTANCES
+        },
+        **{
+            cv.Optional(key): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLIVOLT,
+                icon=ICON_CELL_DEVIATION,
+                accuracy_decimals=1,
+                device_class=DEVICE_CLASS_EMPTY,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ).extend(PUBLISH_FILTER_SCHEMA)
+            for key in CELL_DEVIATIONS
+        },
+    }
+)
+
+
+CONFIG_SCHEMA = CONFIG_SCHEMA.extend(
+    {
+        cv.Optional(f"{channel}_{statistic}"): sensor.sensor_schema(
+            unit_of_measurement=unit,
+            icon=icon,
             accuracy_decimals=3,
-            device_class=DEVICE_CLASS_VOLTAGE,
+            device_class=device_class,
             state_class=STATE_CLASS_MEASUREMENT,
-        ),
+        ).extend(PUBLISH_FILTER_SCHEMA)
+        for channel, (unit, icon, device_class) in WINDOW_CHANNELS.items()
+        for statistic in WINDOW_STATISTICS
+    }
+)
+
+
+CONFIG_SCHEMA = CONFIG_SCHEMA.extend(
+    {
+        cv.Optional(key): sensor.sensor_schema(
+            unit_of_measurement=unit,
+            icon=icon,
+            accuracy_decimals=accuracy_decimals,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=state_class,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ).extend(PUBLISH_FILTER_SCHEMA)
+        for key, (unit, icon, accuracy_decimals, state_class) in DIAGNOSTICS.items()
     }
 )
 
 
+def _final_validate(config):
+    full_config = fv.full_config.get()
+    hub_path = full_config.get_path_for_id(config[CONF_KILOVAULT_BMS_BLE_ID])[:-1]
+    cell_count = full_config.get_config_for_path(hub_path)[CONF_CELL_COUNT]
+    for i in range(cell_count, MAX_CELLS):
+        cell = CELLS[i]
+        statistics = [f"{cell}_{statistic}" for statistic in WINDOW_STATISTICS]
+        for key in [cell, CELL_RESISTANCES[i], CELL_DEVIATIONS[i], *statistics]:
+            if key in config:
+                raise cv.Invalid(
+                    f"{key} is not available with {CONF_CELL_COUNT}: {cell_count}",
+                    path=[key],
+                )
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
+
+def add_feature_define(key):
+    if key in FEATURES:
+        cg.add_define(f"USE_KILOVAULT_{FEATURES[key]}")
+
+
+def setup_publish_filter(hub, sens, conf):
+    if not any(key in conf for key in (CONF_DEADBAND, CONF_RELATIVE_DEADBAND, CONF_HEARTBEAT)):
+        return
+    heartbeat = conf[CONF_HEARTBEAT].total_milliseconds if CONF_HEARTBEAT in conf else 0
+    cg.add(
+        hub.set_publish_filter(
+            sens,
+            conf.get(CONF_DEADBAND, 0.0),
+            conf.get(CONF_RELATIVE_DEADBAND, 0.0),
+            heartbeat,
+        )
+    )
+
+
 async def to_code(config):
     hub = await cg.get_variable(config[CONF_KILOVAULT_BMS_BLE_ID])
     for i, key in enumerate(CELLS):
@@ -249,8 +514,36 @@ async def to_code(config):
             conf = config[key]
             sens = await sensor.new_sensor(conf)
             cg.add(hub.set_cell_voltage_sensor(i, sens))
+            setup_publish_filter(hub, sens, conf)
+            add_feature_define(key)
+    for i, key in enumerate(CELL_RESISTANCES):
+        if key in config:
+            conf = config[key]
+            sens = await sensor.new_sensor(conf)
+            cg.add(hub.set_cell_resistance_sensor(i, sens))
+            setup_publish_filter(hub, sens, conf)
+            add_feature_define(key)
+    for i, key in enumerate(CELL_DEVIATIONS):
+        if key in config:
+            conf = config[key]
+            sens = await sensor.new_sensor(conf)
+            cg.add(hub.set_cell_deviation_sensor(i, sens))
+            setup_publish_filter(hub, sens, conf)
+            add_feature_define(key)
     for key in SENSORS:
         if key in config:
             conf = config[key]
             sens = await sensor.new_sensor(conf)
             cg.add(getattr(hub, f"set_{key}_sensor")(sens))
+            setup_publish_filter(hub, sens, conf)
+            add_feature_define(key)
+    # Channel indices match the WindowChannel enum, the cells beyond cell_count were
+    # rejected in _final_validate() and never get here.
+    for channel, key in enumerate(WINDOW_CHANNELS):
+        for statistic, name in enumerate(WINDOW_STATISTICS):
+            if f"{key}_{name}" in config:
+                conf = config[f"{key}_{name}"]
+                sens = await sensor.new_sensor(conf)
+                cg.add(hub.set_window_sensor(channel, statistic, sens))
+                setup_publish_filter(hub, sens, conf)
+                cg.add_define("USE_KILOVAULT_WINDOWS")
@@ -11,39 +11,66 @@ CODEOWNERS = ["@syssi"]
 
 CONF_CHARGING = "charging"
 CONF_DISCHARGING = "discharging"
+CONF_HOLDING_REGISTER = "holding_register"
+CONF_WRITE_COMMAND = "write_command"
 
 ICON_CHARGING = "mdi:battery-charging-50"
 ICON_DISCHARGING = "mdi:battery-charging-50"
 
-SWITCHES = {
-    CONF_CHARGING: 0xFF,
-    CONF_DISCHARGING: 0xFF,
-}
+# The write protocol of the BMS is not documented. Until a switch gets its holding
+# register, and the platform the command byte that starts a write frame, it is read-only.
+SWITCHES = [
+    CONF_CHARGING,
+    CONF_DISCHARGING,
+]
 
 KilovaultSwitch = kilovault_bms_ble_ns.class_("KilovaultSwitch", switch.Switch, cg.Component)
 
-CONFIG_SCHEMA = cv.Schema(
-    {
-        cv.GenerateID(CONF_KILOVAULT_BMS_BLE_ID): cv.use_id(KilovaultBmsBle),
-        cv.Optional(CONF_CHARGING): switch.SWITCH_SCHEMA.extend(
-            {
-                cv.GenerateID(): cv.declare_id(KilovaultSwitch),
-                cv.Optional(CONF_ICON, default=ICON_CHARGING): cv.icon,
-            }
-        ).extend(cv.COMPONENT_SCHEMA),
-        cv.Optional(CONF_DISCHARGING): switch.SWITCH_SCHEMA.extend(
-            {
-                cv.GenerateID(): cv.declare_id(KilovaultSwitch),
-                cv.Optional(CONF_ICON, default=ICON_DISCHARGING): cv.icon,
-            }
-        ).extend(cv.COMPONENT_SCHEMA),
-    }
+
+
+def validate_writes(config):
+    registers = [
+        config[key][CONF_HOLDING_REGISTER]
+        for key in SWITCHES
+        if key in config and CONF_HOLDING_REGISTER in config[key]
+    ]
+    if registers and CONF_WRITE_COMMAND not in config:
+        raise cv.Invalid(f"{CONF_WRITE_COMMAND} is required to write holding registers")
+    if len(set(registers)) != len(registers):
+        raise cv.Invalid("The switches need distinct holding registers")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.GenerateID(CONF_KILOVAULT_BMS_BLE_ID): cv.use_id(KilovaultBmsBle),
+            cv.Optional(CONF_WRITE_COMMAND): cv.hex_uint8_t,
+            cv.Optional(CONF_CHARGING): switch.SWITCH_SCHEMA.extend(
+                {
+                    cv.GenerateID(): cv.declare_id(KilovaultSwitch),
+                    cv.Optional(CONF_ICON, default=ICON_CHARGING): cv.icon,
+                    cv.Optional(CONF_HOLDING_REGISTER): cv.hex_uint8_t,
+                }
+            ).extend(cv.COMPONENT_SCHEMA),
+            cv.Optional(CONF_DISCHARGING): switch.SWITCH_SCHEMA.extend(
+                {
+                    cv.GenerateID(): cv.declare_id(KilovaultSwitch),
+                    cv.Optional(CONF_ICON, default=ICON_DISCHARGING): cv.icon,
+                    cv.Optional(CONF_HOLDING_REGISTER): cv.hex_uint8_t,
+                }
+            ).extend(cv.COMPONENT_SCHEMA),
+        }
+    ),
+    validate_writes,
 )
 
 
 async def to_code(config):
     hub = await cg.get_variable(config[CONF_KILOVAULT_BMS_BLE_ID])
-    for key, address in SWITCHES.items():
+    if CONF_WRITE_COMMAND in config:
+        cg.add(hub.set_write_command(config[CONF_WRITE_COMMAND]))
+    for key in SWITCHES:
         if key in config:
             conf = config[key]
             var = cg.new_Pvariable(conf[CONF_ID])
@@ -51,4 +78,5 @@ async def to_code(config):
             await switch.register_switch(var, conf)
             cg.add(getattr(hub, f"set_{key}_switch")(var))
             cg.add(var.set_parent(hub))
-            cg.add(var.set_holding_register(address))
+            if CONF_HOLDING_REGISTER in conf:
+                cg.add(var.set_holding_register(conf[CONF_HOLDING_REGISTER]))
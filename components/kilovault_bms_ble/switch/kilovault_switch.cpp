@@ -8,8 +8,26 @@ namespace kilovault_bms_ble {
 static const char *const TAG = "kilovault_bms_ble.switch";
 
 void KilovaultSwitch::dump_config() { LOG_SWITCH("", "KilovaultBmsBle Switch", this); }
+/*
+  Publishes the new state right away and queues the write. If the BMS never
+  acknowledges it, the switch falls back to the state it had before. A read-only
+  switch republishes its state, so the frontend does not keep the refused one.
+*/
 void KilovaultSwitch::write_state(bool state) {
-  // this->parent_->write_register(this->holding_register_, (uint16_t) state);
+  if (!this->writable_) {
+    ESP_LOGW(TAG, "Switch is read-only, configure its holding_register to write it");
+    this->publish_state(this->state);
+    return;
+  }
+
+  bool previous = this->state;
+  this->publish_state(state);
+  this->parent_->write_register(this->holding_register_, (uint16_t) state, [this, previous](bool success) {
+    if (!success) {
+      ESP_LOGW(TAG, "Write failed, restoring %s", ONOFF(previous));
+      this->publish_state(previous);
+    }
+  });
 }
 
 }  // namespace kilovault_bms_ble
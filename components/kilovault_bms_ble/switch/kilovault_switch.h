@@ -11,7 +11,11 @@ class KilovaultBmsBle;
 class KilovaultSwitch : public switch_::Switch, public Component {
  public:
   void set_parent(KilovaultBmsBle *parent) { this->parent_ = parent; };
-  void set_holding_register(uint8_t holding_register) { this->holding_register_ = holding_register; };
+  // Without a holding register the switch only shows the state the BMS reports
+  void set_holding_register(uint8_t holding_register) {
+    this->holding_register_ = holding_register;
+    this->writable_ = true;
+  };
   void dump_config() override;
   void loop() override {}
   float get_setup_priority() const override { return setup_priority::DATA; }
@@ -20,6 +24,7 @@ class KilovaultSwitch : public switch_::Switch, public Component {
   void write_state(bool state) override;
   KilovaultBmsBle *parent_;
   uint8_t holding_register_;
+  bool writable_{false};
 };
 
 }  // namespace kilovault_bms_ble
@@ -17,6 +17,11 @@ TEXT_SENSORS = [
     CONF_MESSAGE,
 ]
 
+# Feature flags, see FEATURES in sensor.py
+FEATURES = {
+    CONF_BATTERY_MAC: "BATTERY_MAC",
+}
+
 CONFIG_SCHEMA = cv.Schema(
     {
         cv.GenerateID(CONF_KILOVAULT_BMS_BLE_ID): cv.use_id(KilovaultBmsBle),
@@ -44,3 +49,5 @@ async def to_code(config):
             sens = cg.new_Pvariable(conf[CONF_ID])
             await text_sensor.register_text_sensor(sens, conf)
             cg.add(getattr(hub, f"set_{key}_text_sensor")(sens))
+            if key in FEATURES:
+                cg.add_define(f"USE_KILOVAULT_{FEATURES[key]}")
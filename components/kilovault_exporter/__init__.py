@@ -0,0 +1,54 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.const import CONF_ADDRESS, CONF_ID, CONF_PORT
+from esphome.components.kilovault_bms_ble import KilovaultBmsBle
+
+# Forwards every frame of several kilovault_bms_ble batteries as a packed binary record
+# over UDP, batched into one datagram per batch_size frames or batch_interval.
+# tools/kilovault_receiver.py decodes them.
+
+CODEOWNERS = ["@syssi"]
+
+DEPENDENCIES = ["kilovault_bms_ble", "network"]
+
+AUTO_LOAD = ["socket"]
+
+CONF_BATTERIES = "batteries"
+CONF_BATCH_SIZE = "batch_size"
+CONF_BATCH_INTERVAL = "batch_interval"
+
+kilovault_exporter_ns = cg.esphome_ns.namespace("kilovault_exporter")
+
+KilovaultExporter = kilovault_exporter_ns.class_("KilovaultExporter", cg.Component)
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(KilovaultExporter),
+        cv.Required(CONF_BATTERIES): cv.All(
+            cv.ensure_list(cv.use_id(KilovaultBmsBle)), cv.Length(min=1)
+        ),
+        # IPv4 address and port of the collector
+        cv.Required(CONF_ADDRESS): cv.string_strict,
+        cv.Optional(CONF_PORT, default=5489): cv.port,
+        # A datagram is sent once it holds this many records (capped to what fits in
+        # one datagram), or when the interval passed with records waiting.
+        cv.Optional(CONF_BATCH_SIZE, default=10): cv.int_range(min=1, max=255),
+        cv.Optional(
+            CONF_BATCH_INTERVAL, default="5s"
+        ): cv.positive_time_period_milliseconds,
+    }
+)
+
+
+# Code Generation
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    for battery_id in config[CONF_BATTERIES]:
+        battery = await cg.get_variable(battery_id)
+        cg.add(var.add_battery(battery))
+    cg.add(var.set_address(config[CONF_ADDRESS]))
+    cg.add(var.set_port(config[CONF_PORT]))
+    cg.add(var.set_batch_size(config[CONF_BATCH_SIZE]))
+    cg.add(var.set_batch_interval(config[CONF_BATCH_INTERVAL]))
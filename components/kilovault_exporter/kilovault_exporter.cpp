@@ -0,0 +1,134 @@
+#include "kilovault_exporter.h"
+#include "esphome/core/log.h"
+#include "esphome/core/hal.h"
+#include "esphome/components/network/util.h"
+
+#ifdef USE_ESP32
+
+#include <cerrno>
+#include <cinttypes>
+
+namespace esphome {
+namespace kilovault_exporter {
+
+static const char *const TAG = "kilovault_exporter";
+
+static uint8_t *put_16(uint8_t *out, uint16_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+  return out + 2;
+}
+
+static uint8_t *put_32(uint8_t *out, uint32_t value) {
+  out = put_16(out, value);
+  return put_16(out, value >> 16);
+}
+
+/* ========================================================================= */
+/*
+  Opens the socket and subscribes to the status callback of every battery. The MAC of
+  a battery is looked up once here, not per frame.
+*/
+void KilovaultExporter::setup() {
+  this->socket_ = socket::socket_ip(SOCK_DGRAM, IPPROTO_IP);
+  if (this->socket_ == nullptr) {
+    ESP_LOGE(TAG, "Could not create socket");
+    this->mark_failed();
+    return;
+  }
+  this->socket_->setblocking(false);
+
+  this->destination_length_ = socket::set_sockaddr((struct sockaddr *) &this->destination_,
+                                                   sizeof(this->destination_), this->address_, this->port_);
+  if (this->destination_length_ == 0) {
+    ESP_LOGE(TAG, "Invalid address %s", this->address_.c_str());
+    this->mark_failed();
+    return;
+  }
+
+  if (this->batch_size_ > MAX_RECORDS)
+    this->batch_size_ = MAX_RECORDS;
+
+  for (auto *battery : this->batteries_) {
+    uint64_t mac = battery->parent()->get_address();
+    battery->add_on_status_callback([this, mac](const StatusData &status_data) { this->add_record_(mac, status_data); });
+  }
+
+  this->set_interval("flush", this->batch_interval_, [this]() {
+    if (this->records_ > 0)
+      this->flush_();
+  });
+}
+
+/* ========================================================================= */
+/*
+  Appends the frame to the datagram and sends it once the batch is full. Frames with
+  status 0 carry no measurements and are skipped.
+*/
+void KilovaultExporter::add_record_(uint64_t mac, const StatusData &status_data) {
+  if (status_data.status == 0)
+    return;
+
+  uint8_t *out = this->datagram_ + HEADER_SIZE + this->records_ * RECORD_SIZE;
+  out = put_32(out, millis());
+  for (int shift = 40; shift >= 0; shift -= 8)
+    *out++ = mac >> shift;
+  out = put_16(out, status_data.voltage);
+  out = put_32(out, status_data.current);
+  out = put_16(out, status_data.state_of_charge);
+  out = put_16(out, status_data.temperature);
+  out = put_16(out, status_data.status);
+  out = put_16(out, status_data.afe_status);
+  for (uint16_t cell_voltage : status_data.cell_voltages)
+    out = put_16(out, cell_voltage);
+
+  if (++this->records_ >= this->batch_size_)
+    this->flush_();
+}
+
+/* ========================================================================= */
+/*
+  Sends the records collected so far as one datagram. Without a network the batch is
+  dropped rather than kept, the collector sees the gap in the sequence numbers.
+*/
+void KilovaultExporter::flush_() {
+  uint8_t *out = this->datagram_;
+  out = put_16(out, MAGIC);
+  *out++ = VERSION;
+  *out++ = CELL_COUNT;
+  *out++ = this->records_;
+  *out++ = 0;
+  put_16(out, this->sequence_++);
+
+  size_t length = HEADER_SIZE + this->records_ * RECORD_SIZE;
+  this->records_ = 0;
+
+  if (!network::is_connected()) {
+    this->failed_count_++;
+    return;
+  }
+
+  ssize_t sent = this->socket_->sendto(this->datagram_, length, 0, (struct sockaddr *) &this->destination_,
+                                       this->destination_length_);
+  if (sent != (ssize_t) length) {
+    this->failed_count_++;
+    ESP_LOGV(TAG, "sendto failed, errno=%d", errno);
+    return;
+  }
+  this->sent_count_++;
+}
+
+/* ========================================================================= */
+void KilovaultExporter::dump_config() {
+  ESP_LOGCONFIG(TAG, "KilovaultExporter:");
+  ESP_LOGCONFIG(TAG, "  Batteries: %u", (unsigned) this->batteries_.size());
+  ESP_LOGCONFIG(TAG, "  Collector: %s:%u", this->address_.c_str(), this->port_);
+  ESP_LOGCONFIG(TAG, "  Record: %u bytes, batch of %u (max %u), interval %" PRIu32 " ms", (unsigned) RECORD_SIZE,
+                this->batch_size_, (unsigned) MAX_RECORDS, this->batch_interval_);
+  ESP_LOGCONFIG(TAG, "  Datagrams sent: %" PRIu32 ", failed: %" PRIu32, this->sent_count_, this->failed_count_);
+}
+
+}  // namespace kilovault_exporter
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/components/socket/socket.h"
+#include "esphome/components/kilovault_bms_ble/kilovault_bms_ble.h"
+
+#ifdef USE_ESP32
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace kilovault_exporter {
+
+using kilovault_bms_ble::CELL_COUNT;
+using kilovault_bms_ble::KilovaultBmsBle;
+using kilovault_bms_ble::StatusData;
+
+/*
+  Compact telemetry export: every frame of the batteries becomes one fixed layout
+  binary record, and the records are batched into one UDP datagram. That is one
+  sendto() per batch instead of a state publish per value and frame.
+
+  Datagram, all values little endian:
+
+    offset  size  header
+    0       2     magic 0x564B, "KV" on the wire
+    2       1     version, 1
+    3       1     cells per record
+    4       1     records in this datagram
+    5       1     reserved, 0
+    6       2     sequence number, counts datagrams to spot lost ones
+
+    offset  size  record, RECORD_SIZE bytes, repeated
+    0       4     millis() when the frame arrived
+    4       6     MAC of the battery, most significant byte first
+    10      2     voltage, mV
+    12      4     current, mA, signed, negative while discharging
+    16      2     state of charge, %
+    18      2     temperature, 0.1 K, signed
+    20      2     status, signed
+    22      2     AFE status
+    24      2*n   cell voltages, mV
+
+  The layout only ever grows at the end of a record, anything else bumps the version.
+*/
+class KilovaultExporter : public Component {
+ public:
+  static constexpr uint16_t MAGIC = 0x564B;
+  static constexpr uint8_t VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 8;
+  static constexpr size_t RECORD_SIZE = 24 + 2 * CELL_COUNT;
+  // Stays below the MTU of WiFi and Ethernet, so datagrams are never fragmented
+  static constexpr size_t MAX_DATAGRAM_SIZE = 1400;
+  static constexpr size_t MAX_RECORDS = (MAX_DATAGRAM_SIZE - HEADER_SIZE) / RECORD_SIZE;
+
+  void setup() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::AFTER_WIFI; }
+
+  void add_battery(KilovaultBmsBle *battery) { this->batteries_.push_back(battery); }
+  void set_address(const std::string &address) { address_ = address; }
+  void set_port(uint16_t port) { port_ = port; }
+  void set_batch_size(uint8_t batch_size) { batch_size_ = batch_size; }
+  void set_batch_interval(uint32_t batch_interval) { batch_interval_ = batch_interval; }
+
+ protected:
+  void add_record_(uint64_t mac, const StatusData &status_data);
+  void flush_();
+
+  std::vector<KilovaultBmsBle *> batteries_;
+  std::string address_;
+  uint16_t port_{5489};
+  uint8_t batch_size_{10};
+  uint32_t batch_interval_{5000};
+
+  std::unique_ptr<socket::Socket> socket_;
+  struct sockaddr_storage destination_{};
+  socklen_t destination_length_{0};
+
+  // The datagram being filled, sent by flush_()
+  uint8_t datagram_[HEADER_SIZE + MAX_RECORDS * RECORD_SIZE]{};
+  uint8_t records_{0};
+  uint16_t sequence_{0};
+  uint32_t sent_count_{0};
+  uint32_t failed_count_{0};
+};
+
+}  // namespace kilovault_exporter
+}  // namespace esphome
+
+#endif
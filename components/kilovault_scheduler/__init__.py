@@ -0,0 +1,54 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.const import CONF_ID
+from esphome.components.kilovault_bms_ble import KilovaultBmsBle
+
+# Rotates one BLE connection through several kilovault_bms_ble batteries: connect,
+# wait for one checksummed frame, publish, disconnect, next battery.
+
+CODEOWNERS = ["@syssi"]
+
+DEPENDENCIES = ["kilovault_bms_ble"]
+
+AUTO_LOAD = ["sensor"]
+
+CONF_KILOVAULT_SCHEDULER_ID = "kilovault_scheduler_id"
+CONF_BATTERIES = "batteries"
+CONF_SLOT_TIMEOUT = "slot_timeout"
+CONF_CYCLE_INTERVAL = "cycle_interval"
+
+kilovault_scheduler_ns = cg.esphome_ns.namespace("kilovault_scheduler")
+
+KilovaultScheduler = kilovault_scheduler_ns.class_(
+    "KilovaultScheduler", cg.Component
+)
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(KilovaultScheduler),
+        cv.Required(CONF_BATTERIES): cv.All(
+            cv.ensure_list(cv.use_id(KilovaultBmsBle)), cv.Length(min=1)
+        ),
+        # Give up on a battery that did not deliver a frame within this time
+        cv.Optional(
+            CONF_SLOT_TIMEOUT, default="30s"
+        ): cv.positive_time_period_milliseconds,
+        # Minimum time between the starts of two rotations. The radio idles for the rest
+        # of it, 0 starts the next rotation right away.
+        cv.Optional(
+            CONF_CYCLE_INTERVAL, default="0s"
+        ): cv.positive_time_period_milliseconds,
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+
+# Code Generation
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    for battery_id in config[CONF_BATTERIES]:
+        battery = await cg.get_variable(battery_id)
+        cg.add(var.add_battery(battery))
+    cg.add(var.set_slot_timeout(config[CONF_SLOT_TIMEOUT]))
+    cg.add(var.set_cycle_interval(config[CONF_CYCLE_INTERVAL]))
@@ -0,0 +1,138 @@
+#include "kilovault_scheduler.h"
+#include "esphome/core/log.h"
+#include "esphome/core/hal.h"
+
+#ifdef USE_ESP32
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace esphome {
+namespace kilovault_scheduler {
+
+static const char *const TAG = "kilovault_scheduler";
+
+/* ========================================================================= */
+/*
+  Takes the ble_client of every battery over and starts the first rotation. The setup
+  priority puts this after the setup of the ble_clients, which enables them, and
+  before the first loop() of the tracker, which would connect them all at once.
+*/
+void KilovaultScheduler::setup() {
+  uint32_t max_frame_gap = this->max_frame_gap_();
+  for (size_t i = 0; i < this->batteries_.size(); i++) {
+    KilovaultBmsBle *battery = this->batteries_[i];
+    battery->set_scheduled(true);
+    battery->set_energy_max_gap(max_frame_gap);
+    battery->parent()->set_enabled(false);
+    battery->add_on_status_callback([this, i](const StatusData &) { this->on_frame_(i); });
+  }
+
+  this->start_cycle_();
+}
+
+/* ========================================================================= */
+/*
+  Called with every checksummed frame of any battery. Only the first frame of the
+  active slot counts, the slot is closed from the main loop since disabling the client
+  tears the connection down.
+*/
+void KilovaultScheduler::on_frame_(size_t index) {
+  if (!this->slot_open_ || index != this->active_)
+    return;
+
+  this->slot_open_ = false;
+  this->cancel_timeout("slot");
+  this->defer([this]() {
+    this->batteries_[this->active_]->update();
+    this->end_slot_();
+  });
+}
+
+/* ========================================================================= */
+void KilovaultScheduler::start_cycle_() {
+  this->cycle_started_ = millis();
+  this->start_slot_(0);
+}
+
+/* ========================================================================= */
+void KilovaultScheduler::start_slot_(size_t index) {
+  this->active_ = index;
+  this->slot_open_ = true;
+
+  KilovaultBmsBle *battery = this->batteries_[index];
+  ESP_LOGV(TAG, "[%s] Slot %u started", battery->parent()->address_str().c_str(), (unsigned) index);
+  battery->parent()->set_enabled(true);
+
+  this->set_timeout("slot", this->slot_timeout_, [this]() {
+    this->slot_open_ = false;
+    this->slot_timeouts_++;
+    ESP_LOGW(TAG, "[%s] No frame within %" PRIu32 " ms, skipping",
+             this->batteries_[this->active_]->parent()->address_str().c_str(), this->slot_timeout_);
+    this->publish_state_(this->slot_timeouts_sensor_, this->slot_timeouts_);
+    this->end_slot_();
+  });
+}
+
+/* ========================================================================= */
+/*
+  Disconnects the active battery and moves on to the next one. At the end of a
+  rotation the cycle time is published and the next rotation is started, right away
+  or once the cycle interval has passed.
+*/
+void KilovaultScheduler::end_slot_() {
+  this->batteries_[this->active_]->parent()->set_enabled(false);
+
+  size_t next = this->active_ + 1;
+  if (next < this->batteries_.size()) {
+    this->start_slot_(next);
+    return;
+  }
+
+  this->cycle_time_ = millis() - this->cycle_started_;
+  ESP_LOGD(TAG, "Rotation over %u batteries took %" PRIu32 " ms", (unsigned) this->batteries_.size(),
+           this->cycle_time_);
+  this->publish_state_(this->cycle_time_sensor_, this->cycle_time_ * 0.001f);
+
+  if (this->cycle_time_ >= this->cycle_interval_) {
+    this->start_cycle_();
+  } else {
+    this->set_timeout("cycle", this->cycle_interval_ - this->cycle_time_, [this]() { this->start_cycle_(); });
+  }
+}
+
+/* ========================================================================= */
+/*
+  Frames of one battery are a rotation apart, plus however long its slot took to
+  deliver. A rotation takes the cycle interval, or longer when every slot runs into
+  its timeout.
+*/
+uint32_t KilovaultScheduler::max_frame_gap_() const {
+  uint32_t rotation = std::max<uint32_t>(this->cycle_interval_, this->batteries_.size() * this->slot_timeout_);
+  return rotation + this->slot_timeout_;
+}
+
+/* ========================================================================= */
+void KilovaultScheduler::dump_config() {
+  ESP_LOGCONFIG(TAG, "KilovaultScheduler:");
+  ESP_LOGCONFIG(TAG, "  Batteries: %u", (unsigned) this->batteries_.size());
+  ESP_LOGCONFIG(TAG, "  Slot timeout: %" PRIu32 " ms", this->slot_timeout_);
+  ESP_LOGCONFIG(TAG, "  Cycle interval: %" PRIu32 " ms", this->cycle_interval_);
+  ESP_LOGCONFIG(TAG, "  Energy max gap: %" PRIu32 " ms", this->max_frame_gap_());
+
+  LOG_SENSOR("", "Cycle time", this->cycle_time_sensor_);
+  LOG_SENSOR("", "Slot timeouts", this->slot_timeouts_sensor_);
+}
+
+/* ========================================================================= */
+void KilovaultScheduler::publish_state_(sensor::Sensor *sensor, float value) {
+  if (sensor == nullptr)
+    return;
+
+  sensor->publish_state(value);
+}
+
+}  // namespace kilovault_scheduler
+}  // namespace esphome
+
+#endif
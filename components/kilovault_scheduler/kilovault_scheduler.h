@@ -0,0 +1,71 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/kilovault_bms_ble/kilovault_bms_ble.h"
+
+#ifdef USE_ESP32
+
+#include <vector>
+
+namespace esphome {
+namespace kilovault_scheduler {
+
+using kilovault_bms_ble::KilovaultBmsBle;
+using kilovault_bms_ble::StatusData;
+
+/*
+  Duty-cycled round robin over more batteries than the ESP32 has BLE connection slots.
+
+  Only one battery is connected at a time. Its ble_client is enabled, and as soon as
+  the battery delivers one checksummed frame it is published and the client disabled
+  again, which drops the connection and hands the radio to the next battery. A battery
+  that does not deliver within the slot timeout is skipped for this rotation.
+
+  After the last battery the rotation starts over, optionally waiting until the cycle
+  interval has passed so the radio idles in between.
+
+  A battery delivers one frame per rotation, so its energy totals integrate across
+  the rotation: its max gap is set to the longest time two of its frames can be apart.
+*/
+class KilovaultScheduler : public Component {
+ public:
+  void setup() override;
+  void dump_config() override;
+  // Right after ble_client, whose setup enables every client
+  float get_setup_priority() const override { return setup_priority::AFTER_BLUETOOTH - 1.0f; }
+
+  void add_battery(KilovaultBmsBle *battery) { this->batteries_.push_back(battery); }
+  void set_slot_timeout(uint32_t slot_timeout) { slot_timeout_ = slot_timeout; }
+  void set_cycle_interval(uint32_t cycle_interval) { cycle_interval_ = cycle_interval; }
+
+  void set_cycle_time_sensor(sensor::Sensor *cycle_time_sensor) { cycle_time_sensor_ = cycle_time_sensor; }
+  void set_slot_timeouts_sensor(sensor::Sensor *slot_timeouts_sensor) { slot_timeouts_sensor_ = slot_timeouts_sensor; }
+
+ protected:
+  void on_frame_(size_t index);
+  void start_cycle_();
+  void start_slot_(size_t index);
+  void end_slot_();
+  uint32_t max_frame_gap_() const;
+
+  std::vector<KilovaultBmsBle *> batteries_;
+  uint32_t slot_timeout_{30000};
+  uint32_t cycle_interval_{0};
+
+  size_t active_{0};
+  bool slot_open_{false};
+  uint32_t cycle_started_{0};
+  uint32_t cycle_time_{0};
+  uint32_t slot_timeouts_{0};
+
+  sensor::Sensor *cycle_time_sensor_{nullptr};
+  sensor::Sensor *slot_timeouts_sensor_{nullptr};
+
+  void publish_state_(sensor::Sensor *sensor, float value);
+};
+
+}  // namespace kilovault_scheduler
+}  // namespace esphome
+
+#endif
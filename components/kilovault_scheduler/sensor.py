@@ -0,0 +1,60 @@
+import esphome.codegen as cg
+from esphome.components import sensor
+import esphome.config_validation as cv
+from esphome.const import (
+    DEVICE_CLASS_EMPTY,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_EMPTY,
+    UNIT_SECOND,
+)
+
+from . import CONF_KILOVAULT_SCHEDULER_ID, KilovaultScheduler
+
+DEPENDENCIES = ["kilovault_scheduler"]
+
+CODEOWNERS = ["@syssi"]
+
+CONF_CYCLE_TIME = "cycle_time"
+CONF_SLOT_TIMEOUTS = "slot_timeouts"
+
+ICON_CYCLE_TIME = "mdi:timer-sync-outline"
+ICON_SLOT_TIMEOUTS = "mdi:timer-alert-outline"
+
+SENSORS = [
+    CONF_CYCLE_TIME,
+    CONF_SLOT_TIMEOUTS,
+]
+
+# pylint: disable=too-many-function-args
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_KILOVAULT_SCHEDULER_ID): cv.use_id(KilovaultScheduler),
+        cv.Optional(CONF_CYCLE_TIME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_SECOND,
+            icon=ICON_CYCLE_TIME,
+            accuracy_decimals=1,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_SLOT_TIMEOUTS): sensor.sensor_schema(
+            unit_of_measurement=UNIT_EMPTY,
+            icon=ICON_SLOT_TIMEOUTS,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+    }
+)
+
+
+async def to_code(config):
+    hub = await cg.get_variable(config[CONF_KILOVAULT_SCHEDULER_ID])
+    for key in SENSORS:
+        if key in config:
+            conf = config[key]
+            sens = await sensor.new_sensor(conf)
+            cg.add(getattr(hub, f"set_{key}_sensor")(sens))
@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+
+#include "support.h"
+
+using namespace esphome::kilovault_bms_ble;
+using namespace esphome::kilovault_bms_ble::testing;
+
+// Notifications of a corpus file, concatenated, with their offsets
+struct Stream {
+  std::vector<uint8_t> bytes;
+  std::vector<std::pair<size_t, size_t>> notifications;
+  size_t frames;
+};
+
+static Stream load_stream(const std::string &name, size_t frames) {
+  Stream stream{{}, {}, frames};
+  for (auto &record : load_corpus(name)) {
+    stream.notifications.emplace_back(stream.bytes.size(), record.data.size());
+    stream.bytes.insert(stream.bytes.end(), record.data.begin(), record.data.end());
+  }
+  return stream;
+}
+
+/*
+  Hex conversion and checksum of one frame payload, the scalar reference against the
+  SWAR decoder the hub uses.
+*/
+template<bool (*Decode)(const uint8_t *, size_t, uint8_t *, uint16_t &)>
+static void BM_HexDecode(benchmark::State &state) {
+  auto records = load_corpus("charge_mtu247.log");
+  const uint8_t *hex = records[0].data.data() + 1;
+  uint8_t payload[KILOVAULT_PAYLOAD_SIZE];
+
+  for (auto _ : state) {
+    uint16_t sum = 0;
+    benchmark::DoNotOptimize(hex);
+    bool valid = Decode(hex, KILOVAULT_PAYLOAD_SIZE, payload, sum);
+    benchmark::DoNotOptimize(valid);
+    benchmark::DoNotOptimize(sum);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * KILOVAULT_PAYLOAD_SIZE * 2);
+}
+BENCHMARK_TEMPLATE(BM_HexDecode, hex_decode_scalar)->Name("BM_HexDecode/scalar");
+BENCHMARK_TEMPLATE(BM_HexDecode, hex_decode_swar)->Name("BM_HexDecode/swar");
+
+/*
+  Notification in to snapshot out: GATT callback, framer, decoder and checksum, for
+  every notification of the capture. Reported per frame.
+*/
+static void BM_NotifyPath(benchmark::State &state, const char *name, size_t frames) {
+  esphome::testing::reset();
+  esphome::ble_client::BLEClient client;
+  TestHub hub{};
+  hub.set_client(&client);
+  hub.setup();
+  hub.connect();
+  Stream stream = load_stream(name, frames);
+
+  for (auto _ : state) {
+    for (auto &notification : stream.notifications)
+      hub.notify(stream.bytes.data() + notification.first, notification.second);
+  }
+  state.SetItemsProcessed(state.iterations() * stream.frames);
+  state.SetBytesProcessed(state.iterations() * stream.bytes.size());
+}
+BENCHMARK_CAPTURE(BM_NotifyPath, mtu23, "discharge_mtu23.log", 10);
+BENCHMARK_CAPTURE(BM_NotifyPath, mtu247, "charge_mtu247.log", 5);
+
+// The publish side: one snapshot decoded and published to a full set of sensors
+static void BM_Publish(benchmark::State &state) {
+  esphome::testing::reset();
+  esphome::ble_client::BLEClient client;
+  TestHub hub{};
+  hub.set_client(&client);
+  esphome::sensor::Sensor sensors[12];
+  hub.set_voltage_sensor(&sensors[0]);
+  hub.set_current_sensor(&sensors[1]);
+  hub.set_power_sensor(&sensors[2]);
+  hub.set_temperature_sensor(&sensors[3]);
+  hub.set_state_of_charge_sensor(&sensors[4]);
+  hub.set_min_cell_voltage_sensor(&sensors[5]);
+  hub.set_max_cell_voltage_sensor(&sensors[6]);
+  hub.set_delta_cell_voltage_sensor(&sensors[7]);
+  for (uint8_t i = 0; i < CELL_COUNT; i++)
+    hub.set_cell_voltage_sensor(i, &sensors[8 + i]);
+  hub.setup();
+  hub.connect();
+  Stream stream = load_stream("charge_mtu247.log", 5);
+
+  for (auto _ : state) {
+    hub.notify(stream.bytes.data(), MAX_RESPONSE_SIZE);
+    hub.update();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Publish);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,199 @@
+#pragma once
+
+// Host side of the capture: reads a dump_capture() log back into its notifications,
+// for the replay tool, the fuzz seeds and the tests.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+struct CaptureRecord {
+  uint32_t timestamp;
+  std::vector<uint8_t> data;
+};
+
+/*
+  Reads the output of KilovaultBmsBle::dump_capture() back, e.g. from a saved log, so the
+  capture can be replayed through the framer on a host:
+
+    capture begin <records> <bytes>
+    <timestamp> <length> <first 64 bytes as hex>
+      + <next 64 bytes as hex>
+    capture end
+
+  Lines may still carry the log prefix ("[I][kilovault_bms_ble:571]: ") and colour codes.
+  Lines starting with '#' and everything outside a capture are skipped. The record count
+  and byte total of "capture begin" must match what follows. A later capture in the same
+  log replaces an earlier one, as it holds the newer traffic.
+*/
+class CaptureDumpParser {
+ public:
+  static constexpr size_t BYTES_PER_LINE = 64;
+
+  // Returns false on a line that breaks the format, the reason is in error()
+  bool parse_line(const std::string &raw) {
+    std::string line = strip_(raw);
+    if (line.empty() || line[0] == '#')
+      return true;
+
+    if (line.compare(0, 14, "capture begin ") == 0) {
+      if (this->state_ == State::INSIDE)
+        return this->fail_("capture begin inside a capture");
+      unsigned long records, bytes;
+      size_t offset;
+      if (!parse_number_(line, 14, &records, &offset) || !parse_number_(line, offset, &bytes, &offset) ||
+          offset != line.size())
+        return this->fail_("malformed capture begin");
+      this->parsed_.clear();
+      this->expected_records_ = records;
+      this->expected_bytes_ = bytes;
+      this->state_ = State::INSIDE;
+      return true;
+    }
+    if (this->state_ != State::INSIDE)
+      return true;
+
+    if (line == "capture end") {
+      if (!this->close_record_())
+        return false;
+      size_t bytes = 0;
+      for (auto &record : this->parsed_)
+        bytes += CaptureBuffer::HEADER_SIZE + record.data.size();
+      if (this->parsed_.size() != this->expected_records_ || bytes != this->expected_bytes_)
+        return this->fail_("capture end does not match capture begin");
+      this->records_.swap(this->parsed_);
+      this->parsed_.clear();
+      this->complete_ = true;
+      this->state_ = State::OUTSIDE;
+      return true;
+    }
+
+    if (line[0] == '+') {
+      if (this->parsed_.empty() || line.size() < 2 || line[1] != ' ')
+        return this->fail_("continuation without a record");
+      CaptureRecord &record = this->parsed_.back();
+      size_t remaining = this->expected_length_ - record.data.size();
+      size_t count = (line.size() - 2) / 2;
+      if (count == 0 || count != std::min(remaining, BYTES_PER_LINE))
+        return this->fail_("continuation of the wrong length");
+      return parse_hex_(line, 2, count, &record.data) || this->fail_("malformed hex");
+    }
+
+    if (!this->close_record_())
+      return false;
+    unsigned long timestamp, length;
+    size_t offset;
+    if (!parse_number_(line, 0, &timestamp, &offset) || !parse_number_(line, offset, &length, &offset) ||
+        timestamp > UINT32_MAX || length > UINT16_MAX)
+      return this->fail_("malformed record");
+    size_t first = std::min<size_t>(length, BYTES_PER_LINE);
+    if (line.size() != offset + 2 * first)
+      return this->fail_("record of the wrong length");
+    this->parsed_.push_back({uint32_t(timestamp), {}});
+    this->parsed_.back().data.reserve(length);
+    this->expected_length_ = length;
+    return parse_hex_(line, offset, first, &this->parsed_.back().data) || this->fail_("malformed hex");
+  }
+
+  // True once a capture was read completely, a truncated log leaves this false
+  bool complete() const { return this->complete_; }
+  const std::vector<CaptureRecord> &records() const { return this->records_; }
+  const std::string &error() const { return this->error_; }
+  size_t line_number() const { return this->line_; }
+
+ protected:
+  enum class State : uint8_t { OUTSIDE, INSIDE };
+
+  bool fail_(const char *reason) {
+    this->error_ = reason;
+    this->state_ = State::OUTSIDE;
+    return false;
+  }
+
+  // The record read last must have all the bytes its header announced
+  bool close_record_() {
+    if (!this->parsed_.empty() && this->parsed_.back().data.size() != this->expected_length_)
+      return this->fail_("record is missing its continuation lines");
+    return true;
+  }
+
+  // Drops the log prefix, colour codes and surrounding whitespace
+  std::string strip_(const std::string &raw) {
+    this->line_++;
+    std::string line;
+    line.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); i++) {
+      if (raw[i] == '\033') {
+        while (i < raw.size() && raw[i] != 'm')
+          i++;
+        continue;
+      }
+      line += raw[i];
+    }
+    size_t prefix = line.find("]: ");
+    if (prefix != std::string::npos)
+      line.erase(0, prefix + 3);
+    size_t begin = line.find_first_not_of(" \t");
+    size_t end = line.find_last_not_of(" \t\r\n");
+    return begin == std::string::npos ? std::string() : line.substr(begin, end - begin + 1);
+  }
+
+  // Decimal number at offset, followed by a single space or the end of the line. next is
+  // where the following field starts.
+  static bool parse_number_(const std::string &line, size_t offset, unsigned long *value, size_t *next) {
+    if (offset >= line.size() || line[offset] < '0' || line[offset] > '9')
+      return false;
+    char *end;
+    *value = strtoul(line.c_str() + offset, &end, 10);
+    *next = end - line.c_str();
+    if (*next == line.size())
+      return true;
+    if (line[*next] != ' ')
+      return false;
+    (*next)++;
+    return true;
+  }
+
+  static bool parse_hex_(const std::string &line, size_t offset, size_t count, std::vector<uint8_t> *data) {
+    if (line.size() != offset + 2 * count)
+      return false;
+    for (size_t i = 0; i < count; i++) {
+      int high = hex_digit_(line[offset + 2 * i]);
+      int low = hex_digit_(line[offset + 2 * i + 1]);
+      if (high < 0 || low < 0)
+        return false;
+      data->push_back(uint8_t(high << 4 | low));
+    }
+    return true;
+  }
+
+  static int hex_digit_(char c) {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+
+  State state_{State::OUTSIDE};
+  std::vector<CaptureRecord> parsed_;
+  std::vector<CaptureRecord> records_;
+  size_t expected_records_{0};
+  size_t expected_bytes_{0};
+  size_t expected_length_{0};
+  size_t line_{0};
+  bool complete_{false};
+  std::string error_;
+};
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
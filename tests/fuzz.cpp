@@ -0,0 +1,234 @@
+// Fuzz target for the notify path: arbitrary chunk sequences go through
+// gattc_event_handler(ESP_GATTC_NOTIFY_EVT, ...) into assemble_(), with disconnects and
+// updates mixed in. Besides memory safety (build with ASan and UBSan) every notification
+// is checked for its cost:
+//
+//  - every byte is accounted for, it ends up in a completed frame, in the dropped
+//    bytes or in the partial frame the framer holds on to
+//  - no notification completes more than length / MAX_RESPONSE_SIZE + 1 frames
+//  - no notification takes longer than MAX_NOTIFY_TIME_US
+//
+// An input is a sequence of operations, each starting with an opcode byte:
+//
+//  - low three bits 0..5: a notification. Two bytes little endian length follow (modulo
+//    MAX_NOTIFY_SIZE + 64, so oversized ones are covered), then the value. Bit 3 sends
+//    it from another handle, the upper four bits advance the clock by 100 ms each.
+//  - 6: update(), which publishes the newest frame
+//  - 7: a disconnect followed by a reconnect
+//
+// With Clang this builds kilovault_libfuzzer against libFuzzer. The seeds are the corpus
+// captures, written in the input format by the driver:
+//
+//     kilovault_fuzz --seeds seeds/ && kilovault_libfuzzer seeds/
+//
+// Without libFuzzer, kilovault_fuzz runs the seeds and a fixed number of deterministic
+// mutations of them, which is what ctest does.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include "support.h"
+
+using namespace esphome;
+using namespace esphome::kilovault_bms_ble;
+
+// Far above what the notify path takes even under the sanitizers, so only a stall trips it
+static const uint32_t MAX_NOTIFY_TIME_US = 20000;
+
+static const uint8_t OP_UPDATE = 6;
+static const uint8_t OP_RECONNECT = 7;
+static const uint16_t FOREIGN_HANDLE = 0x07;
+
+static uint32_t worst_notify_us = 0;
+
+#define FUZZ_CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      abort(); \
+    } \
+  } while (0)
+
+static void notify(kilovault_bms_ble::testing::TestHub &hub, uint16_t handle, const uint8_t *data, uint16_t length) {
+  uint32_t frames = hub.get_frame_count();
+  uint32_t dropped = hub.get_dropped_bytes();
+  size_t pending = hub.pending_bytes();
+
+  esp_ble_gattc_cb_param_t param{};
+  param.notify.handle = handle;
+  param.notify.value = const_cast<uint8_t *>(data);
+  param.notify.value_len = length;
+  param.notify.is_notify = true;
+  auto start = std::chrono::steady_clock::now();
+  hub.gattc_event_handler(ESP_GATTC_NOTIFY_EVT, 3, &param);
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+  worst_notify_us = std::max<uint32_t>(worst_notify_us, elapsed.count());
+  FUZZ_CHECK(elapsed.count() <= MAX_NOTIFY_TIME_US);
+
+  uint32_t completed = hub.get_frame_count() - frames;
+  size_t accounted = (hub.get_dropped_bytes() - dropped) + completed * MAX_RESPONSE_SIZE + hub.pending_bytes();
+  if (handle != ble_client::BLEClient::NOTIFY_HANDLE || length == 0) {
+    FUZZ_CHECK(completed == 0 && accounted == pending);
+  } else if (length > MAX_NOTIFY_SIZE) {
+    FUZZ_CHECK(completed == 0 && accounted == pending + length);
+  } else {
+    FUZZ_CHECK(completed <= length / MAX_RESPONSE_SIZE + 1u);
+    FUZZ_CHECK(accounted == pending + length);
+  }
+}
+
+static void run(const uint8_t *data, size_t size) {
+  esphome::testing::reset();
+  ble_client::BLEClient client;
+  sensor::Sensor voltage, min_cell_voltage, max_cell_voltage, min_voltage_cell, max_voltage_cell;
+  sensor::Sensor cells[CELL_COUNT];
+  auto hub = std::make_unique<kilovault_bms_ble::testing::TestHub>();
+  hub->set_client(&client);
+  hub->set_capture_size(300);
+  hub->set_voltage_sensor(&voltage);
+  hub->set_min_cell_voltage_sensor(&min_cell_voltage);
+  hub->set_max_cell_voltage_sensor(&max_cell_voltage);
+  hub->set_min_voltage_cell_sensor(&min_voltage_cell);
+  hub->set_max_voltage_cell_sensor(&max_voltage_cell);
+  for (uint8_t i = 0; i < CELL_COUNT; i++)
+    hub->set_cell_voltage_sensor(i, &cells[i]);
+  hub->setup();
+  hub->connect();
+
+  const uint8_t *end = data + size;
+  while (data < end) {
+    uint8_t op = *data++;
+    uint8_t kind = op & 0x07;
+    if (kind == OP_UPDATE) {
+      hub->update();
+      continue;
+    }
+    if (kind == OP_RECONNECT) {
+      hub->disconnect();
+      FUZZ_CHECK(hub->pending_bytes() == 0);
+      hub->connect();
+      continue;
+    }
+
+    if (end - data < 2)
+      break;
+    uint16_t length = (data[0] | data[1] << 8) % (MAX_NOTIFY_SIZE + 64);
+    data += 2;
+    length = std::min<size_t>(length, end - data);
+    esphome::testing::advance_millis((op >> 4) * 100);
+    // A copy of exactly the value, so ASan catches any read past it
+    std::vector<uint8_t> value(data, data + length);
+    notify(*hub, (op & 0x08) ? FOREIGN_HANDLE : ble_client::BLEClient::NOTIFY_HANDLE, value.data(), length);
+    data += length;
+  }
+  hub->update();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  run(data, size);
+  return 0;
+}
+
+#ifndef KILOVAULT_LIBFUZZER
+
+// A capture in the input format, one notification per record with its timing
+static std::vector<uint8_t> encode_capture(const std::vector<kilovault_bms_ble::testing::CaptureRecord> &records) {
+  std::vector<uint8_t> input;
+  uint32_t last = records.empty() ? 0 : records.front().timestamp;
+  for (auto &record : records) {
+    uint32_t steps = std::min<uint32_t>((record.timestamp - last) / 100, 15);
+    last = record.timestamp;
+    input.push_back(steps << 4);
+    input.push_back(record.data.size());
+    input.push_back(record.data.size() >> 8);
+    input.insert(input.end(), record.data.begin(), record.data.end());
+  }
+  return input;
+}
+
+static void mutate(std::vector<uint8_t> &input, const std::vector<std::vector<uint8_t>> &seeds, std::mt19937 &rng) {
+  int count = 1 + rng() % 8;
+  for (int i = 0; i < count; i++) {
+    size_t at = input.empty() ? 0 : rng() % input.size();
+    switch (rng() % 6) {
+      case 0:  // Corrupt a byte
+        if (!input.empty())
+          input[at] = rng();
+        break;
+      case 1:  // A stray preamble
+        input.insert(input.begin() + at, KILOVAULT_PKT_START_A);
+        break;
+      case 2:  // Lose a run of bytes
+        input.erase(input.begin() + at, input.begin() + std::min(input.size(), at + rng() % 130));
+        break;
+      case 3: {  // Splice in a piece of another seed
+        auto &other = seeds[rng() % seeds.size()];
+        size_t from = rng() % other.size();
+        size_t to = std::min(other.size(), from + rng() % 600);
+        input.insert(input.begin() + at, other.begin() + from, other.begin() + to);
+        break;
+      }
+      case 4: {  // An oversized notification
+        uint16_t length = MAX_NOTIFY_SIZE + 1 + rng() % 63;
+        std::vector<uint8_t> op{0, uint8_t(length), uint8_t(length >> 8)};
+        op.resize(op.size() + length, '0' + rng() % 10);
+        input.insert(input.begin() + at, op.begin(), op.end());
+        break;
+      }
+      case 5:  // An update or a reconnect
+        input.insert(input.begin() + at, rng() % 2 ? OP_UPDATE : OP_RECONNECT);
+        break;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t iterations = 10000;
+  const char *seed_dir = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) {
+      seed_dir = argv[++i];
+    } else {
+      iterations = strtoul(argv[i], nullptr, 10);
+    }
+  }
+
+  std::vector<std::vector<uint8_t>> seeds;
+  for (auto &entry : std::filesystem::directory_iterator(KILOVAULT_CORPUS_DIR)) {
+    if (entry.path().extension() != ".log")
+      continue;
+    seeds.push_back(encode_capture(kilovault_bms_ble::testing::load_capture(entry.path().string())));
+    if (seed_dir != nullptr) {
+      std::filesystem::create_directories(seed_dir);
+      std::ofstream out(std::filesystem::path(seed_dir) / entry.path().stem(), std::ios::binary);
+      out.write(reinterpret_cast<const char *>(seeds.back().data()), seeds.back().size());
+    }
+  }
+  if (seed_dir != nullptr)
+    return 0;
+  if (seeds.empty()) {
+    fprintf(stderr, "No captures in %s\n", KILOVAULT_CORPUS_DIR);
+    return 1;
+  }
+
+  for (auto &seed : seeds)
+    run(seed.data(), seed.size());
+
+  std::mt19937 rng(1);
+  for (uint32_t i = 0; i < iterations; i++) {
+    auto input = seeds[rng() % seeds.size()];
+    mutate(input, seeds, rng);
+    run(input.data(), input.size());
+  }
+  printf("%zu seeds and %u mutations, slowest notification %u us\n", seeds.size(), iterations, worst_notify_us);
+  return 0;
+}
+
+#endif
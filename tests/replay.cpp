@@ -0,0 +1,86 @@
+// Feeds a capture dumped by dump_capture() back through the notification handler and
+// assemble_(), with the original chunking, and prints every decoded frame and the
+// framer counters. Copy the log lines from "capture begin" to "capture end" into a
+// file; the log prefixes do not need to be removed. Run on a Linux host:
+//
+//     kilovault_replay [--speed FACTOR] [--quiet] capture.log
+//
+// Without --speed the notifications are fed as fast as possible, with it they are
+// spaced like on the link, divided by FACTOR. Either way the clock of the hub follows
+// the timestamps of the capture.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "support.h"
+
+using namespace esphome;
+using namespace esphome::kilovault_bms_ble;
+
+static int usage(const char *name) {
+  fprintf(stderr, "Usage: %s [--speed FACTOR] [--quiet] capture.log\n", name);
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  double speed = 0;
+  bool quiet = false;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+      if (speed <= 0)
+        return usage(argv[0]);
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else if (argv[i][0] == '-' || path != nullptr) {
+      return usage(argv[0]);
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path == nullptr)
+    return usage(argv[0]);
+
+  std::vector<kilovault_bms_ble::testing::CaptureRecord> records;
+  try {
+    records = kilovault_bms_ble::testing::load_capture(path);
+  } catch (const std::runtime_error &err) {
+    fprintf(stderr, "%s\n", err.what());
+    return 1;
+  }
+
+  ble_client::BLEClient client;
+  kilovault_bms_ble::testing::TestHub hub{};
+  hub.set_client(&client);
+  hub.add_on_status_callback([&quiet](const StatusData &data) {
+    if (quiet)
+      return;
+    printf("%u %.3f V %.3f A %u %% %.1f °C status %u afe 0x%04X cells", esphome::millis(), data.voltage / 1000.0f,
+           data.current / 1000.0f, data.state_of_charge, data.temperature / 10.0f - 273.15f, data.status,
+           data.afe_status);
+    for (uint8_t i = 0; i < CELL_COUNT; i++)
+      printf(" %.3f", data.cell_voltages[i] / 1000.0f);
+    printf("\n");
+  });
+  hub.setup();
+
+  esphome::testing::set_millis(records.empty() ? 0 : records.front().timestamp);
+  hub.connect();
+  for (size_t i = 0; i < records.size(); i++) {
+    if (speed > 0 && i > 0) {
+      uint32_t gap = records[i].timestamp - records[i - 1].timestamp;
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(gap / speed));
+    }
+    esphome::testing::set_millis(records[i].timestamp);
+    hub.notify(records[i].data);
+  }
+
+  printf("notifications %u frames %u crc_failures %u resyncs %u dropped_bytes %u empty_frames %u oversize %u\n",
+         hub.get_notification_count(), hub.get_frame_count(), hub.get_crc_failure_count(), hub.get_resync_count(),
+         hub.get_dropped_bytes(), hub.get_empty_frame_count(), hub.get_oversize_count());
+  return 0;
+}
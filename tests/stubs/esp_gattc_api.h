@@ -0,0 +1,80 @@
+#pragma once
+
+// Host stand-in for the parts of the ESP-IDF GATT client API the components use.
+
+#include <cstdint>
+
+typedef int esp_err_t;
+typedef int esp_gattc_cb_event_t;
+typedef int esp_gatt_status_t;
+typedef uint8_t esp_gatt_if_t;
+typedef uint8_t esp_bd_addr_t[6];
+
+enum {
+  ESP_GATTC_REG_EVT,
+  ESP_GATTC_OPEN_EVT,
+  ESP_GATTC_CLOSE_EVT,
+  ESP_GATTC_CONNECT_EVT,
+  ESP_GATTC_DISCONNECT_EVT,
+  ESP_GATTC_SEARCH_CMPL_EVT,
+  ESP_GATTC_REG_FOR_NOTIFY_EVT,
+  ESP_GATTC_NOTIFY_EVT,
+  ESP_GATTC_CFG_MTU_EVT,
+  ESP_GATTC_WRITE_CHAR_EVT,
+};
+
+enum { ESP_GATT_OK = 0, ESP_GATT_ERROR = 0x85 };
+enum { ESP_GATT_WRITE_TYPE_NO_RSP = 1, ESP_GATT_WRITE_TYPE_RSP = 2 };
+enum { ESP_GATT_AUTH_REQ_NONE = 0 };
+
+#define ESP_GATT_DEF_BLE_MTU_SIZE 23
+#define ESP_GATT_MAX_MTU_SIZE 517
+
+typedef union {
+  struct {
+    esp_gatt_status_t status;
+    uint16_t app_id;
+  } reg;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    uint16_t mtu;
+  } open;
+  struct {
+    int reason;
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+  } disconnect;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+    uint16_t mtu;
+  } cfg_mtu;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t handle;
+  } reg_for_notify;
+  struct {
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    uint16_t handle;
+    uint16_t value_len;
+    uint8_t *value;
+    bool is_notify;
+  } notify;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+    uint16_t handle;
+    uint16_t offset;
+  } write;
+} esp_ble_gattc_cb_param_t;
+
+esp_err_t esp_ble_gattc_register_for_notify(esp_gatt_if_t gattc_if, uint8_t *server_bda, uint16_t handle);
+esp_err_t esp_ble_gattc_write_char(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t handle, uint16_t value_len,
+                                   uint8_t *value, int write_type, int auth_req);
+esp_err_t esp_ble_gattc_write_char_descr(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t handle,
+                                         uint16_t value_len, uint8_t *value, int write_type, int auth_req);
+esp_err_t esp_ble_gattc_send_mtu_req(esp_gatt_if_t gattc_if, uint16_t conn_id);
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu);
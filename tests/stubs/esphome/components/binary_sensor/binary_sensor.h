@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace binary_sensor {
+
+// Host stand-in for BinarySensor, keeps the last state and how often it was published
+class BinarySensor {
+ public:
+  void publish_state(bool state) {
+    this->state = state;
+    this->publish_count++;
+  }
+  bool has_state() const { return this->publish_count != 0; }
+  std::string get_name() const { return this->name; }
+
+  std::string name{"binary_sensor"};
+  bool state{false};
+  uint32_t publish_count{0};
+};
+
+}  // namespace binary_sensor
+}  // namespace esphome
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <esp_gattc_api.h>
+
+#include "esphome/core/component.h"
+#include "esphome/components/esp32_ble_tracker/esp32_ble_tracker.h"
+
+namespace esphome {
+namespace ble_client {
+
+struct BLECharacteristic {
+  uint16_t handle;
+};
+
+struct BLEDescriptor {
+  uint16_t handle;
+};
+
+/*
+  Host stand-in for BLEClient. Every client serves the same service with the handles
+  below, tests give each one its own address.
+*/
+class BLEClient {
+ public:
+  static constexpr uint16_t NOTIFY_HANDLE = 0x12;
+  static constexpr uint16_t COMMAND_HANDLE = 0x15;
+  static constexpr uint16_t CCCD_HANDLE = 0x13;
+
+  BLECharacteristic *get_characteristic(uint16_t service, uint16_t characteristic) {
+    if (characteristic == 0xFFE4)
+      return &this->notify_characteristic_;
+    if (characteristic == 0xFA02)
+      return &this->command_characteristic_;
+    return nullptr;
+  }
+  BLEDescriptor *get_config_descriptor(uint16_t handle) { return &this->cccd_; }
+
+  std::string address_str() const {
+    char buffer[18];
+    snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X", this->remote_bda_[0], this->remote_bda_[1],
+             this->remote_bda_[2], this->remote_bda_[3], this->remote_bda_[4], this->remote_bda_[5]);
+    return buffer;
+  }
+  uint64_t get_address() const {
+    uint64_t address = 0;
+    for (uint8_t byte : this->remote_bda_)
+      address = (address << 8) | byte;
+    return address;
+  }
+  void set_address(uint64_t address) {
+    for (int i = 5; i >= 0; i--, address >>= 8)
+      this->remote_bda_[i] = address & 0xFF;
+  }
+  uint8_t *get_remote_bda() { return this->remote_bda_; }
+  esp_gatt_if_t get_gattc_if() const { return 3; }
+  uint16_t get_conn_id() const { return this->conn_id; }
+
+  void set_enabled(bool enabled) { this->enabled = enabled; }
+  esp32_ble_tracker::ClientState state() const { return this->state_; }
+  void set_state(esp32_ble_tracker::ClientState state) { this->state_ = state; }
+
+  bool enabled{true};
+  uint16_t conn_id{0};
+
+ protected:
+  uint8_t remote_bda_[6]{0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+  esp32_ble_tracker::ClientState state_{esp32_ble_tracker::ClientState::IDLE};
+  BLECharacteristic notify_characteristic_{NOTIFY_HANDLE};
+  BLECharacteristic command_characteristic_{COMMAND_HANDLE};
+  BLEDescriptor cccd_{CCCD_HANDLE};
+};
+
+class BLEClientNode {
+ public:
+  virtual ~BLEClientNode() = default;
+  virtual void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
+                                   esp_ble_gattc_cb_param_t *param) = 0;
+  virtual void loop() {}
+  BLEClient *parent() { return this->parent_; }
+  void set_client(BLEClient *client) { this->parent_ = client; }
+
+ protected:
+  BLEClient *parent_{nullptr};
+  esp32_ble_tracker::ClientState node_state{esp32_ble_tracker::ClientState::IDLE};
+};
+
+}  // namespace ble_client
+}  // namespace esphome
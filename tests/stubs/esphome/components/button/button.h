@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+namespace esphome {
+namespace button {
+
+// Host stand-in for Button
+class Button {
+ public:
+  virtual ~Button() = default;
+  void press() { this->press_action(); }
+  std::string get_name() const { return this->name; }
+
+  std::string name{"button"};
+
+ protected:
+  virtual void press_action() = 0;
+};
+
+}  // namespace button
+}  // namespace esphome
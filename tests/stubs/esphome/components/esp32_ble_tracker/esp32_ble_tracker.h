@@ -0,0 +1,19 @@
+#pragma once
+
+namespace esphome {
+namespace esp32_ble_tracker {
+
+enum class ClientState {
+  INIT,
+  DISCONNECTING,
+  IDLE,
+  SEARCHING,
+  DISCOVERED,
+  READY_TO_CONNECT,
+  CONNECTING,
+  CONNECTED,
+  ESTABLISHED,
+};
+
+}  // namespace esp32_ble_tracker
+}  // namespace esphome
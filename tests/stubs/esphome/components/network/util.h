@@ -0,0 +1,9 @@
+#pragma once
+
+namespace esphome {
+namespace network {
+
+inline bool is_connected() { return true; }
+
+}  // namespace network
+}  // namespace esphome
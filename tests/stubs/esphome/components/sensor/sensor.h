@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace sensor {
+
+// Host stand-in for Sensor, keeps the last state and how often it was published
+class Sensor {
+ public:
+  void publish_state(float state) {
+    this->state = state;
+    this->publish_count++;
+  }
+  float get_state() const { return this->state; }
+  bool has_state() const { return this->publish_count != 0; }
+  std::string get_name() const { return this->name; }
+
+  std::string name{"sensor"};
+  float state{NAN};
+  uint32_t publish_count{0};
+};
+
+}  // namespace sensor
+}  // namespace esphome
@@ -0,0 +1,48 @@
+#pragma once
+
+// Host stand-in for the ESPHome socket wrapper, backed by BSD sockets.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace esphome {
+namespace socket {
+
+class Socket {
+ public:
+  explicit Socket(int fd) : fd_(fd) {}
+  ~Socket() { ::close(this->fd_); }
+
+  int setblocking(bool blocking) {
+    int flags = fcntl(this->fd_, F_GETFL);
+    return fcntl(this->fd_, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+  }
+  ssize_t sendto(const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen) {
+    return ::sendto(this->fd_, buf, len, flags, to, tolen);
+  }
+
+ protected:
+  int fd_;
+};
+
+inline std::unique_ptr<Socket> socket_ip(int type, int protocol) {
+  int fd = ::socket(AF_INET, type, protocol);
+  return fd < 0 ? nullptr : std::unique_ptr<Socket>(new Socket(fd));
+}
+
+inline socklen_t set_sockaddr(struct sockaddr *addr, socklen_t addrlen, const std::string &ip_address, uint16_t port) {
+  auto *server = reinterpret_cast<struct sockaddr_in *>(addr);
+  server->sin_family = AF_INET;
+  server->sin_port = htons(port);
+  return inet_pton(AF_INET, ip_address.c_str(), &server->sin_addr) == 1 ? sizeof(*server) : 0;
+}
+
+}  // namespace socket
+}  // namespace esphome
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace switch_ {
+
+// Host stand-in for Switch, turn_on() and turn_off() go through write_state() like on the device
+class Switch {
+ public:
+  virtual ~Switch() = default;
+  void publish_state(bool state) {
+    this->state = state;
+    this->publish_count++;
+  }
+  void turn_on() { this->write_state(true); }
+  void turn_off() { this->write_state(false); }
+  std::string get_name() const { return this->name; }
+
+  std::string name{"switch"};
+  bool state{false};
+  uint32_t publish_count{0};
+
+ protected:
+  virtual void write_state(bool state) = 0;
+};
+
+}  // namespace switch_
+}  // namespace esphome
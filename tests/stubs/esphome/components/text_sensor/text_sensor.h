@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace text_sensor {
+
+// Host stand-in for TextSensor, keeps the last state and how often it was published
+class TextSensor {
+ public:
+  void publish_state(const std::string &state) {
+    this->state = state;
+    this->publish_count++;
+  }
+  bool has_state() const { return this->publish_count != 0; }
+  std::string get_name() const { return this->name; }
+
+  std::string name{"text_sensor"};
+  std::string state;
+  uint32_t publish_count{0};
+};
+
+}  // namespace text_sensor
+}  // namespace esphome
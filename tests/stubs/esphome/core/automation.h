@@ -0,0 +1,19 @@
+#pragma once
+
+#include <tuple>
+
+namespace esphome {
+
+// Host stand-in for Trigger, remembers how often it fired and with what
+template<typename... Ts> class Trigger {
+ public:
+  void trigger(Ts... x) {
+    this->fired++;
+    this->last = std::make_tuple(x...);
+  }
+
+  unsigned fired{0};
+  std::tuple<Ts...> last{};
+};
+
+}  // namespace esphome
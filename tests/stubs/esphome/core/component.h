@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "esphome/core/hal.h"
+
+namespace esphome {
+
+namespace setup_priority {
+const float BUS = 1000.0f;
+const float IO = 900.0f;
+const float HARDWARE = 800.0f;
+const float DATA = 600.0f;
+const float PROCESSOR = 400.0f;
+const float BLUETOOTH = 350.0f;
+const float AFTER_BLUETOOTH = 300.0f;
+const float WIFI = 250.0f;
+const float AFTER_WIFI = 200.0f;
+const float AFTER_CONNECTION = 100.0f;
+const float LATE = -100.0f;
+}  // namespace setup_priority
+
+/*
+  Host stand-in for Component. Timeouts, intervals and deferred calls are kept per
+  component and run by run_scheduler(), against the host clock.
+*/
+class Component {
+ public:
+  virtual ~Component() = default;
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual void on_shutdown() {}
+  virtual float get_setup_priority() const { return setup_priority::DATA; }
+
+  // Runs everything that is due, deferred calls first
+  void run_scheduler();
+  bool has_timeout(const std::string &name) const { return this->timeouts_.count(name) != 0; }
+  bool is_failed() const { return this->failed_; }
+
+ protected:
+  struct Scheduled {
+    uint32_t due;
+    uint32_t interval;  // 0 for a timeout
+    std::function<void()> callback;
+  };
+
+  void set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f);
+  void set_timeout(uint32_t timeout, std::function<void()> &&f);
+  bool cancel_timeout(const std::string &name) { return this->timeouts_.erase(name) != 0; }
+  void set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f);
+  void set_interval(uint32_t interval, std::function<void()> &&f);
+  bool cancel_interval(const std::string &name) { return this->timeouts_.erase(name) != 0; }
+  void defer(std::function<void()> &&f) { this->deferred_.push_back(std::move(f)); }
+  void defer(const std::string &name, std::function<void()> &&f) { this->defer(std::move(f)); }
+  void mark_failed() { this->failed_ = true; }
+  void status_set_warning() {}
+  void status_clear_warning() {}
+
+  std::map<std::string, Scheduled> timeouts_;
+  std::vector<std::function<void()>> deferred_;
+  uint32_t anonymous_{0};
+  bool failed_{false};
+};
+
+class PollingComponent : public Component {
+ public:
+  PollingComponent() = default;
+  explicit PollingComponent(uint32_t update_interval) : update_interval_(update_interval) {}
+  virtual void update() = 0;
+  uint32_t get_update_interval() const { return this->update_interval_; }
+  void set_update_interval(uint32_t update_interval) { this->update_interval_ = update_interval; }
+
+ protected:
+  uint32_t update_interval_{10000};
+};
+
+}  // namespace esphome
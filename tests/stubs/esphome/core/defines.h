@@ -0,0 +1,3 @@
+#pragma once
+
+// The feature flags code generation would write here are passed by the host build.
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+
+// The host clock only moves when a test moves it, see testing.h
+uint32_t millis();
+uint32_t micros();
+
+}  // namespace esphome
@@ -0,0 +1,48 @@
+#pragma once
+
+// Host stand-in for the ESPHome logger. Messages go nowhere, but the format strings are
+// still checked against their arguments. KILOVAULT_HOST_LOG=1 prints them to stderr.
+
+#include <cstdio>
+
+namespace esphome {
+namespace testing {
+bool log_enabled();
+}  // namespace testing
+}  // namespace esphome
+
+#define ESPHOME_LOG_LEVEL_NONE 0
+#define ESPHOME_LOG_LEVEL_ERROR 1
+#define ESPHOME_LOG_LEVEL_WARN 2
+#define ESPHOME_LOG_LEVEL_INFO 3
+#define ESPHOME_LOG_LEVEL_CONFIG 4
+#define ESPHOME_LOG_LEVEL_DEBUG 5
+#define ESPHOME_LOG_LEVEL_VERBOSE 6
+#define ESPHOME_LOG_LEVEL_VERY_VERBOSE 7
+#ifndef ESPHOME_LOG_LEVEL
+#define ESPHOME_LOG_LEVEL ESPHOME_LOG_LEVEL_VERY_VERBOSE
+#endif
+
+#define ESPHOME_HOST_LOG_(level, tag, format, ...) \
+  do { \
+    if (esphome::testing::log_enabled()) \
+      fprintf(stderr, "[" level "][%s]: " format "\n", tag, ##__VA_ARGS__); \
+  } while (0)
+
+#define ESP_LOGE(tag, ...) ESPHOME_HOST_LOG_("E", tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESPHOME_HOST_LOG_("W", tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESPHOME_HOST_LOG_("I", tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ESPHOME_HOST_LOG_("C", tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESPHOME_HOST_LOG_("D", tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ESPHOME_HOST_LOG_("V", tag, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) ESPHOME_HOST_LOG_("VV", tag, __VA_ARGS__)
+
+#define LOG_SENSOR(prefix, type, obj) (void) (obj)
+#define LOG_BINARY_SENSOR(prefix, type, obj) (void) (obj)
+#define LOG_TEXT_SENSOR(prefix, type, obj) (void) (obj)
+#define LOG_SWITCH(prefix, type, obj) (void) (obj)
+#define LOG_BUTTON(prefix, type, obj) (void) (obj)
+#define LOG_UPDATE_INTERVAL(obj) (void) (obj)
+
+#define YESNO(b) ((b) ? "YES" : "NO")
+#define ONOFF(b) ((b) ? "ON" : "OFF")
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace esphome {
+
+// Host stand-in for the preference store, kept in memory so tests can reboot a component
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  explicit ESPPreferenceObject(std::vector<uint8_t> *storage) : storage_(storage) {}
+
+  template<typename T> bool save(const T *src) {
+    if (this->storage_ == nullptr)
+      return false;
+    this->storage_->assign(reinterpret_cast<const uint8_t *>(src), reinterpret_cast<const uint8_t *>(src) + sizeof(T));
+    return true;
+  }
+  template<typename T> bool load(T *dest) {
+    if (this->storage_ == nullptr || this->storage_->size() != sizeof(T))
+      return false;
+    memcpy(dest, this->storage_->data(), sizeof(T));
+    return true;
+  }
+
+ protected:
+  std::vector<uint8_t> *storage_{nullptr};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type, bool in_flash = false) {
+    return ESPPreferenceObject(&this->storage_[type]);
+  }
+  bool sync() { return true; }
+  void reset() { this->storage_.clear(); }
+
+ protected:
+  std::map<uint32_t, std::vector<uint8_t>> storage_;
+};
+
+extern ESPPreferences *global_preferences;
+
+}  // namespace esphome
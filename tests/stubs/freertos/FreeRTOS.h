@@ -0,0 +1,14 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS types used by the decode task.
+
+#include <cstdint>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
@@ -0,0 +1,223 @@
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include <esp_gattc_api.h>
+#include <freertos/task.h>
+
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+#include "testing.h"
+
+namespace esphome {
+
+static uint32_t host_millis = 0;
+static uint32_t host_micros = 0;
+static std::vector<testing::GattWrite> host_gatt_writes;
+static uint32_t host_failing_gatt_writes = 0;
+static uint16_t host_local_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+static uint32_t host_local_mtu_calls = 0;
+static uint32_t host_mtu_requests = 0;
+static ESPPreferences host_preferences;
+
+ESPPreferences *global_preferences = &host_preferences;
+
+uint32_t millis() { return host_millis; }
+uint32_t micros() { return host_micros; }
+
+std::string format_hex(const uint8_t *data, size_t length) {
+  static const char *const HEX = "0123456789abcdef";
+  std::string ret;
+  ret.reserve(length * 2);
+  for (size_t i = 0; i < length; i++) {
+    ret += HEX[data[i] >> 4];
+    ret += HEX[data[i] & 0x0F];
+  }
+  return ret;
+}
+
+std::string format_hex_pretty(const uint8_t *data, size_t length) {
+  static const char *const HEX = "0123456789ABCDEF";
+  std::string ret;
+  for (size_t i = 0; i < length; i++) {
+    if (i != 0)
+      ret += '.';
+    ret += HEX[data[i] >> 4];
+    ret += HEX[data[i] & 0x0F];
+  }
+  if (length > 4)
+    ret += " (" + std::to_string(length) + ")";
+  return ret;
+}
+
+uint32_t fnv1_hash(const std::string &str) {
+  uint32_t hash = 2166136261UL;
+  for (char c : str) {
+    hash *= 16777619UL;
+    hash ^= c;
+  }
+  return hash;
+}
+
+// Deterministic, so backoff jitter is the same on every run
+uint32_t random_uint32() {
+  static uint32_t state = 0x12345678;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+void Component::set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f) {
+  this->timeouts_[name] = Scheduled{millis() + timeout, 0, std::move(f)};
+}
+
+void Component::set_timeout(uint32_t timeout, std::function<void()> &&f) {
+  this->set_timeout("__anonymous_" + std::to_string(this->anonymous_++), timeout, std::move(f));
+}
+
+void Component::set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f) {
+  this->timeouts_[name] = Scheduled{millis() + interval, interval, std::move(f)};
+}
+
+void Component::set_interval(uint32_t interval, std::function<void()> &&f) {
+  this->set_interval("__anonymous_" + std::to_string(this->anonymous_++), interval, std::move(f));
+}
+
+void Component::run_scheduler() {
+  std::vector<std::function<void()>> deferred;
+  deferred.swap(this->deferred_);
+  for (auto &f : deferred)
+    f();
+
+  std::vector<std::string> due;
+  for (auto &entry : this->timeouts_) {
+    if ((int32_t) (millis() - entry.second.due) >= 0)
+      due.push_back(entry.first);
+  }
+  for (auto &name : due) {
+    auto it = this->timeouts_.find(name);
+    if (it == this->timeouts_.end())
+      continue;  // Cancelled by an earlier callback
+    std::function<void()> callback = it->second.callback;
+    if (it->second.interval != 0) {
+      it->second.due += it->second.interval;
+    } else {
+      this->timeouts_.erase(it);
+    }
+    callback();
+  }
+}
+
+namespace testing {
+
+bool log_enabled() {
+  static const bool ENABLED = getenv("KILOVAULT_HOST_LOG") != nullptr;
+  return ENABLED;
+}
+
+void set_millis(uint32_t now) { host_millis = now; }
+void advance_millis(uint32_t delta) {
+  host_millis += delta;
+  host_micros += delta * 1000;
+}
+void set_micros(uint32_t now) { host_micros = now; }
+
+std::vector<GattWrite> &gatt_writes() { return host_gatt_writes; }
+void fail_gatt_writes(uint32_t count) { host_failing_gatt_writes = count; }
+uint16_t local_mtu() { return host_local_mtu; }
+uint32_t local_mtu_calls() { return host_local_mtu_calls; }
+uint32_t mtu_requests() { return host_mtu_requests; }
+
+void reset() {
+  host_millis = 0;
+  host_micros = 0;
+  host_gatt_writes.clear();
+  host_failing_gatt_writes = 0;
+  host_local_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+  host_local_mtu_calls = 0;
+  host_mtu_requests = 0;
+  host_preferences.reset();
+}
+
+}  // namespace testing
+}  // namespace esphome
+
+esp_err_t esp_ble_gattc_register_for_notify(esp_gatt_if_t gattc_if, uint8_t *server_bda, uint16_t handle) {
+  return ESP_GATT_OK;
+}
+
+esp_err_t esp_ble_gattc_write_char(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t handle, uint16_t value_len,
+                                   uint8_t *value, int write_type, int auth_req) {
+  if (esphome::host_failing_gatt_writes > 0) {
+    esphome::host_failing_gatt_writes--;
+    return ESP_GATT_ERROR;
+  }
+  esphome::host_gatt_writes.push_back({handle, std::vector<uint8_t>(value, value + value_len)});
+  return ESP_GATT_OK;
+}
+
+esp_err_t esp_ble_gattc_write_char_descr(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t handle,
+                                         uint16_t value_len, uint8_t *value, int write_type, int auth_req) {
+  esphome::host_gatt_writes.push_back({handle, std::vector<uint8_t>(value, value + value_len)});
+  return ESP_GATT_OK;
+}
+
+esp_err_t esp_ble_gattc_send_mtu_req(esp_gatt_if_t gattc_if, uint16_t conn_id) {
+  esphome::host_mtu_requests++;
+  return ESP_GATT_OK;
+}
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu) {
+  esphome::host_local_mtu = mtu;
+  esphome::host_local_mtu_calls++;
+  return ESP_GATT_OK;
+}
+
+// Tasks run on a detached std::thread, notifications are a counting semaphore per task
+struct HostTask {
+  std::mutex mutex;
+  std::condition_variable condition;
+  uint32_t notifications{0};
+};
+
+static thread_local HostTask *current_task = nullptr;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+  auto *task = new HostTask();
+  if (handle != nullptr)
+    *handle = task;
+  std::thread([task, function, parameter]() {
+    current_task = task;
+    function(parameter);
+  }).detach();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+  HostTask *task = current_task;
+  std::unique_lock<std::mutex> lock(task->mutex);
+  if (ticks_to_wait == portMAX_DELAY) {
+    task->condition.wait(lock, [task]() { return task->notifications != 0; });
+  } else {
+    task->condition.wait_for(lock, std::chrono::milliseconds(ticks_to_wait),
+                             [task]() { return task->notifications != 0; });
+  }
+  uint32_t notifications = task->notifications;
+  if (notifications != 0)
+    task->notifications = clear_on_exit ? 0 : notifications - 1;
+  return notifications;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+  }
+  task->condition.notify_one();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Controls and records of the host stand-ins, for tests and tools only.
+
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace testing {
+
+struct GattWrite {
+  uint16_t handle;
+  std::vector<uint8_t> value;
+};
+
+void set_millis(uint32_t now);
+void advance_millis(uint32_t delta);
+void set_micros(uint32_t now);
+
+// Every esp_ble_gattc_write_char() and esp_ble_gattc_write_char_descr(), in order
+std::vector<GattWrite> &gatt_writes();
+// The next count esp_ble_gattc_write_char() calls fail without being recorded
+void fail_gatt_writes(uint32_t count);
+// Value of the last esp_ble_gatt_set_local_mtu() and how often the MTU calls were made
+uint16_t local_mtu();
+uint32_t local_mtu_calls();
+uint32_t mtu_requests();
+
+// Puts the clock, the records and the preference store back to their initial state
+void reset();
+
+}  // namespace testing
+}  // namespace esphome
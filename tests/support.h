@@ -0,0 +1,132 @@
+#pragma once
+
+// Shared by the host tests, benchmarks and tools: a hub with its internals in reach,
+// the corpus loader and a frame encoder.
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "esphome/components/kilovault_bms_ble/kilovault_bms_ble.h"
+#include "capture_dump.h"
+#include "testing.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+// KilovaultBmsBle with the protected parts the tests look at made public. Like the
+// code generation does, create it value initialized (TestHub() or TestHub{}), so the
+// entities that are not set are null.
+class TestHub : public KilovaultBmsBle {
+ public:
+  using KilovaultBmsBle::assemble_;
+  using KilovaultBmsBle::command_queue_;
+  using KilovaultBmsBle::energy_;
+  using KilovaultBmsBle::local_mtu_;
+  using KilovaultBmsBle::negotiated_mtu_;
+  using KilovaultBmsBle::node_state;
+
+  // ble_client registering with the GATT client, once at boot
+  void registered() {
+    esp_ble_gattc_cb_param_t param{};
+    param.reg.status = ESP_GATT_OK;
+    this->gattc_event_handler(ESP_GATTC_REG_EVT, 3, &param);
+  }
+
+  // Connects and subscribes, the way ble_client drives a fresh connection
+  void connect() {
+    esp_ble_gattc_cb_param_t param{};
+    param.open.status = ESP_GATT_OK;
+    this->gattc_event_handler(ESP_GATTC_OPEN_EVT, 3, &param);
+    this->gattc_event_handler(ESP_GATTC_SEARCH_CMPL_EVT, 3, &param);
+    param = {};
+    param.reg_for_notify.status = ESP_GATT_OK;
+    param.reg_for_notify.handle = ble_client::BLEClient::NOTIFY_HANDLE;
+    this->gattc_event_handler(ESP_GATTC_REG_FOR_NOTIFY_EVT, 3, &param);
+  }
+
+  void disconnect() {
+    esp_ble_gattc_cb_param_t param{};
+    this->gattc_event_handler(ESP_GATTC_DISCONNECT_EVT, 3, &param);
+  }
+
+  void notify(const uint8_t *data, uint16_t length) {
+    esp_ble_gattc_cb_param_t param{};
+    param.notify.handle = ble_client::BLEClient::NOTIFY_HANDLE;
+    param.notify.value = const_cast<uint8_t *>(data);
+    param.notify.value_len = length;
+    param.notify.is_notify = true;
+    this->gattc_event_handler(ESP_GATTC_NOTIFY_EVT, 3, &param);
+  }
+  void notify(const std::vector<uint8_t> &data) { this->notify(data.data(), data.size()); }
+
+  // Bytes of the partial frame the framer is holding on to
+  size_t pending_bytes() const {
+    return this->framer_state_ == FramerState::IN_FRAME ? this->frame_length_ : 0;
+  }
+};
+
+// Reads a capture in dump_capture() format, see tests/corpus/
+inline std::vector<CaptureRecord> load_capture(const std::string &path) {
+  std::ifstream file(path);
+  if (!file)
+    throw std::runtime_error("Can not open " + path);
+
+  CaptureDumpParser parser;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!parser.parse_line(line))
+      throw std::runtime_error(path + ":" + std::to_string(parser.line_number()) + ": " + parser.error());
+  }
+  if (!parser.complete())
+    throw std::runtime_error(path + ": no complete capture");
+  return parser.records();
+}
+
+#ifdef KILOVAULT_CORPUS_DIR
+inline std::vector<CaptureRecord> load_corpus(const std::string &name) {
+  return load_capture(std::string(KILOVAULT_CORPUS_DIR) + "/" + name);
+}
+#endif
+
+// Builds a status frame as the BMS sends it, with a correct checksum
+inline std::vector<uint8_t> encode_frame(const StatusData &data) {
+  uint8_t payload[KILOVAULT_PAYLOAD_SIZE]{};
+  auto put16 = [&payload](uint8_t offset, uint16_t value) {
+    payload[(offset - 1) / 2] = value;
+    payload[(offset - 1) / 2 + 1] = value >> 8;
+  };
+  put16(layout_v1::Voltage::OFFSET, data.voltage);
+  put16(layout_v1::Current::OFFSET, uint32_t(data.current));
+  put16(layout_v1::Current::OFFSET + 4, uint32_t(data.current) >> 16);
+  put16(layout_v1::TotalCapacity::OFFSET, data.total_capacity);
+  put16(layout_v1::TotalCapacity::OFFSET + 4, data.total_capacity >> 16);
+  put16(layout_v1::Cycles::OFFSET, data.cycles);
+  put16(layout_v1::StateOfCharge::OFFSET, data.state_of_charge);
+  put16(layout_v1::Temperature::OFFSET, data.temperature);
+  put16(layout_v1::Status::OFFSET, data.status);
+  put16(layout_v1::AfeStatus::OFFSET, data.afe_status);
+  for (uint8_t i = 0; i < CELL_COUNT; i++)
+    put16(45 + 4 * i, data.cell_voltages[i]);
+
+  uint16_t sum = 0;
+  for (uint8_t i = 0; i < KILOVAULT_CHECKSUM_SIZE; i++)
+    sum += payload[i];
+  payload[KILOVAULT_CHECKSUM_SIZE] = sum >> 8;
+  payload[KILOVAULT_CHECKSUM_SIZE + 1] = sum;
+
+  static const char *const HEX = "0123456789ABCDEF";
+  std::vector<uint8_t> frame{KILOVAULT_PKT_START_A};
+  for (uint8_t byte : payload) {
+    frame.push_back(HEX[byte >> 4]);
+    frame.push_back(HEX[byte & 0x0F]);
+  }
+  return frame;
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -0,0 +1,151 @@
+// Checks that the notify -> decode -> publish path stays off the heap once a connection
+// is up. operator new is replaced for the whole executable, which is why this is not
+// part of kilovault_tests.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "support.h"
+
+static std::atomic<bool> counting{false};
+static std::atomic<size_t> allocations{0};
+
+void *operator new(size_t size) {
+  if (counting)
+    allocations++;
+  void *ptr = malloc(size ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+// The array and sized forms forward to these two
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+// Allocations made while it is in scope
+class AllocationCounter {
+ public:
+  AllocationCounter() {
+    allocations = 0;
+    counting = true;
+  }
+  ~AllocationCounter() { counting = false; }
+  size_t count() const { return allocations; }
+};
+
+class AllocTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    esphome::testing::reset();
+    this->hub_ = std::make_unique<TestHub>();
+    auto &hub = *this->hub_;
+    hub.set_client(&this->client_);
+    hub.set_capture_size(1024);
+    hub.set_voltage_sensor(&this->sensors_[0]);
+    hub.set_current_sensor(&this->sensors_[1]);
+    hub.set_power_sensor(&this->sensors_[2]);
+    hub.set_charging_power_sensor(&this->sensors_[3]);
+    hub.set_discharging_power_sensor(&this->sensors_[4]);
+    hub.set_cycles_sensor(&this->sensors_[5]);
+    hub.set_state_of_charge_sensor(&this->sensors_[6]);
+    hub.set_total_capacity_sensor(&this->sensors_[7]);
+    hub.set_current_capacity_sensor(&this->sensors_[8]);
+    hub.set_status_sensor(&this->sensors_[9]);
+    hub.set_afestatus_sensor(&this->sensors_[10]);
+    hub.set_temperature_sensor(&this->sensors_[11]);
+    hub.set_min_cell_voltage_sensor(&this->sensors_[12]);
+    hub.set_max_cell_voltage_sensor(&this->sensors_[13]);
+    hub.set_min_voltage_cell_sensor(&this->sensors_[14]);
+    hub.set_max_voltage_cell_sensor(&this->sensors_[15]);
+    hub.set_delta_cell_voltage_sensor(&this->sensors_[16]);
+    hub.set_charged_energy_sensor(&this->sensors_[17]);
+    hub.set_discharged_energy_sensor(&this->sensors_[18]);
+    hub.set_charged_capacity_sensor(&this->sensors_[19]);
+    hub.set_discharged_capacity_sensor(&this->sensors_[20]);
+    hub.set_window_sensor(0, 0, &this->sensors_[21]);
+    hub.set_frame_rate_sensor(&this->sensors_[22]);
+    hub.set_crc_failures_sensor(&this->sensors_[23]);
+    hub.set_resyncs_sensor(&this->sensors_[24]);
+    hub.set_publish_suppression_sensor(&this->sensors_[25]);
+    hub.set_decode_time_p95_sensor(&this->sensors_[26]);
+    for (uint8_t i = 0; i < CELL_COUNT; i++) {
+      hub.set_cell_voltage_sensor(i, &this->cells_[i]);
+      hub.set_cell_deviation_sensor(i, &this->deviations_[i]);
+    }
+    hub.set_alarm_binary_sensor(&this->alarm_);
+    hub.set_battery_mac_text_sensor(&this->mac_);
+    hub.setup();
+    hub.connect();
+  }
+
+  // Feeds the frames in chunks of 20 to 59 bytes, with update() after every chunk
+  void feed(const std::vector<std::vector<uint8_t>> &frames) {
+    size_t n = 0;
+    for (auto &frame : frames) {
+      for (size_t i = 0; i < frame.size(); n++) {
+        size_t length = std::min(frame.size() - i, 20 + n % 40);
+        esphome::testing::advance_millis(50);
+        this->hub_->notify(frame.data() + i, length);
+        this->hub_->update();
+        i += length;
+      }
+    }
+  }
+
+  static std::vector<uint8_t> frame(int i) {
+    StatusData data{};
+    data.voltage = 13000 + i;
+    data.current = (i % 2 ? 1 : -1) * (1500 + 10 * i);
+    data.total_capacity = 100000;
+    data.state_of_charge = 80;
+    data.temperature = 2981;
+    data.status = 1;
+    for (uint8_t c = 0; c < CELL_COUNT; c++)
+      data.cell_voltages[c] = 3300 + c + i % 7;
+    return encode_frame(data);
+  }
+
+  ble_client::BLEClient client_;
+  std::unique_ptr<TestHub> hub_;
+  sensor::Sensor sensors_[27];
+  sensor::Sensor cells_[CELL_COUNT], deviations_[CELL_COUNT];
+  binary_sensor::BinarySensor alarm_;
+  text_sensor::TextSensor mac_;
+};
+
+TEST_F(AllocTest, SteadyStateDoesNotAllocate) {
+  std::vector<std::vector<uint8_t>> frames;
+  for (int i = 0; i < 200; i++)
+    frames.push_back(frame(i));
+  // Warm up: the first frame publishes the MAC once for the connection
+  this->feed({frames[0]});
+  EXPECT_EQ(1u, this->mac_.publish_count);
+
+  AllocationCounter counter;
+  this->feed(frames);
+  EXPECT_EQ(0u, counter.count());
+  EXPECT_EQ(201u, this->hub_->get_frame_count());
+}
+
+TEST_F(AllocTest, NoisyLinkDoesNotAllocate) {
+  auto records = load_corpus("noisy_mtu23.log");
+  this->feed({frame(0)});
+
+  AllocationCounter counter;
+  for (auto &record : records) {
+    this->hub_->notify(record.data);
+    this->hub_->update();
+  }
+  EXPECT_EQ(0u, counter.count());
+  EXPECT_EQ(2u, this->hub_->get_crc_failure_count());
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "support.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+class BmsBleTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    esphome::testing::reset();
+    this->frames_.clear();
+    this->hub_ = std::make_unique<TestHub>();
+    this->hub_->set_client(&this->client_);
+    this->hub_->set_voltage_sensor(&this->voltage_);
+    this->hub_->set_current_sensor(&this->current_);
+    this->hub_->set_power_sensor(&this->power_);
+    this->hub_->set_temperature_sensor(&this->temperature_);
+    this->hub_->set_state_of_charge_sensor(&this->state_of_charge_);
+    this->hub_->set_current_capacity_sensor(&this->current_capacity_);
+    this->hub_->set_status_sensor(&this->status_);
+    this->hub_->set_afestatus_sensor(&this->afe_status_);
+    this->hub_->set_min_cell_voltage_sensor(&this->min_cell_voltage_);
+    this->hub_->set_max_cell_voltage_sensor(&this->max_cell_voltage_);
+    this->hub_->set_max_voltage_cell_sensor(&this->max_voltage_cell_);
+    this->hub_->set_min_voltage_cell_sensor(&this->min_voltage_cell_);
+    this->hub_->set_delta_cell_voltage_sensor(&this->delta_cell_voltage_);
+    for (uint8_t i = 0; i < CELL_COUNT; i++)
+      this->hub_->set_cell_voltage_sensor(i, &this->cells_[i]);
+    this->hub_->add_on_status_callback([this](const StatusData &data) { this->frames_.push_back(data); });
+    this->hub_->setup();
+    this->hub_->connect();
+  }
+
+  // Feeds the notifications of a corpus file with their original timing
+  void replay(const std::string &name) {
+    for (auto &record : load_corpus(name)) {
+      esphome::testing::set_millis(record.timestamp);
+      this->hub_->notify(record.data);
+    }
+  }
+
+  ble_client::BLEClient client_;
+  std::unique_ptr<TestHub> hub_;
+  sensor::Sensor voltage_, current_, power_, temperature_, state_of_charge_, current_capacity_, status_, afe_status_;
+  sensor::Sensor min_cell_voltage_, max_cell_voltage_, max_voltage_cell_, min_voltage_cell_, delta_cell_voltage_;
+  sensor::Sensor cells_[CELL_COUNT];
+  std::vector<StatusData> frames_;
+};
+
+TEST_F(BmsBleTest, DecodesChunkedFrames) {
+  this->replay("discharge_mtu23.log");
+  EXPECT_EQ(70u, this->hub_->get_notification_count());
+  EXPECT_EQ(10u, this->hub_->get_frame_count());
+  EXPECT_EQ(0u, this->hub_->get_crc_failure_count());
+  EXPECT_EQ(0u, this->hub_->get_resync_count());
+  EXPECT_EQ(0u, this->hub_->get_dropped_bytes());
+  ASSERT_EQ(10u, this->frames_.size());
+  for (int k = 0; k < 10; k++) {
+    EXPECT_EQ(13312 - k, this->frames_[k].voltage);
+    EXPECT_EQ(-1520 - 10 * k, this->frames_[k].current);
+    EXPECT_EQ(3330 - k, this->frames_[k].cell_voltages[2]);
+  }
+
+  // Only the newest frame is published
+  this->hub_->update();
+  EXPECT_EQ(1u, this->voltage_.publish_count);
+  EXPECT_FLOAT_EQ(13.303f, this->voltage_.state);
+  EXPECT_FLOAT_EQ(-1.610f, this->current_.state);
+  EXPECT_FLOAT_EQ(-21.417f, this->power_.state);  // 13.303 V * -1.61 A
+  EXPECT_FLOAT_EQ(24.95f, this->temperature_.state);
+  EXPECT_FLOAT_EQ(87.0f, this->state_of_charge_.state);
+  EXPECT_FLOAT_EQ(87.0f, this->current_capacity_.state);
+  EXPECT_FLOAT_EQ(1.0f, this->status_.state);
+  EXPECT_FLOAT_EQ(3.312f, this->cells_[0].state);
+  EXPECT_FLOAT_EQ(3.321f, this->cells_[2].state);
+  EXPECT_FLOAT_EQ(3.312f, this->min_cell_voltage_.state);
+  EXPECT_FLOAT_EQ(3.321f, this->max_cell_voltage_.state);
+  EXPECT_FLOAT_EQ(3.0f, this->max_voltage_cell_.state);
+  EXPECT_NEAR(0.009f, this->delta_cell_voltage_.state, 1e-6f);
+}
+
+TEST_F(BmsBleTest, DecodesWholeFrameNotifications) {
+  this->replay("charge_mtu247.log");
+  EXPECT_EQ(5u, this->hub_->get_notification_count());
+  EXPECT_EQ(5u, this->hub_->get_frame_count());
+  ASSERT_EQ(5u, this->frames_.size());
+
+  this->hub_->update();
+  EXPECT_FLOAT_EQ(14.108f, this->voltage_.state);
+  EXPECT_FLOAT_EQ(25.4f, this->current_.state);
+  EXPECT_FLOAT_EQ(358.343f, this->power_.state);  // whole mW
+  EXPECT_FLOAT_EQ(25.95f, this->temperature_.state);
+  EXPECT_FLOAT_EQ(44.0f, this->state_of_charge_.state);
+  EXPECT_FLOAT_EQ(3.0f, this->afe_status_.state);
+  EXPECT_FLOAT_EQ(3.528f, this->min_cell_voltage_.state);
+}
+
+TEST_F(BmsBleTest, SurvivesANoisyLink) {
+  this->replay("noisy_mtu23.log");
+  EXPECT_EQ(47u, this->hub_->get_notification_count());
+  EXPECT_EQ(6u, this->hub_->get_frame_count());
+  EXPECT_EQ(2u, this->hub_->get_crc_failure_count());
+  EXPECT_EQ(1u, this->hub_->get_resync_count());
+  EXPECT_EQ(1u, this->hub_->get_empty_frame_count());
+
+  // Frames 1, 5, 6 (empty) and 7 made it through
+  ASSERT_EQ(4u, this->frames_.size());
+  EXPECT_EQ(3324, this->frames_[0].cell_voltages[3]);
+  EXPECT_EQ(3328, this->frames_[1].cell_voltages[3]);
+  EXPECT_EQ(0, this->frames_[2].status);
+  EXPECT_EQ(3330, this->frames_[3].cell_voltages[3]);
+}
+
+TEST_F(BmsBleTest, ChunkingDoesNotChangeTheResult) {
+  std::vector<uint8_t> stream;
+  for (auto &record : load_corpus("noisy_mtu23.log"))
+    stream.insert(stream.end(), record.data.begin(), record.data.end());
+
+  std::vector<StatusData> reference;
+  for (uint16_t chunk : {1, 7, 20, 121, 244, 512}) {
+    this->SetUp();
+    for (size_t offset = 0; offset < stream.size(); offset += chunk)
+      this->hub_->notify(stream.data() + offset, std::min<size_t>(chunk, stream.size() - offset));
+    if (reference.empty())
+      reference = this->frames_;
+    ASSERT_EQ(reference.size(), this->frames_.size()) << chunk;
+    for (size_t i = 0; i < reference.size(); i++)
+      EXPECT_EQ(0, memcmp(&reference[i], &this->frames_[i], sizeof(StatusData))) << chunk;
+  }
+  // The lost notification of frame 2 leaves it to resync on frame 3
+  EXPECT_EQ(4u, reference.size());
+}
+
+TEST_F(BmsBleTest, DropsAPartialFrameOnDisconnect) {
+  auto records = load_corpus("discharge_mtu23.log");
+  for (size_t i = 0; i < 3; i++)
+    this->hub_->notify(records[i].data);
+  this->hub_->disconnect();
+  this->hub_->connect();
+  for (size_t i = 3; i < records.size(); i++)
+    this->hub_->notify(records[i].data);
+
+  // Frame 0 is lost, the 60 bytes it had are dropped along with its tail
+  EXPECT_EQ(9u, this->frames_.size());
+  EXPECT_EQ(13311, this->frames_[0].voltage);
+}
+
+TEST_F(BmsBleTest, EmptyFrameOnlyPublishesTheStatus) {
+  StatusData empty{};
+  this->hub_->notify(encode_frame(empty));
+  this->hub_->update();
+  EXPECT_EQ(1u, this->status_.publish_count);
+  EXPECT_EQ(0u, this->voltage_.publish_count);
+}
+
+TEST_F(BmsBleTest, EmptyFrameKeepsTheUnpublishedSnapshot) {
+  StatusData data{};
+  data.voltage = 13300;
+  data.status = 1;
+  this->hub_->notify(encode_frame(data));
+  StatusData empty{};
+  this->hub_->notify(encode_frame(empty));
+  EXPECT_EQ(1u, this->hub_->get_empty_frame_count());
+
+  this->hub_->update();
+  EXPECT_EQ(1u, this->voltage_.publish_count);
+  EXPECT_FLOAT_EQ(13.3f, this->voltage_.state);
+  EXPECT_FLOAT_EQ(1.0f, this->status_.state);
+}
+
+TEST_F(BmsBleTest, NoConnectedCellLeavesNoMinimumCell) {
+  StatusData data{};
+  data.voltage = 13300;
+  data.state_of_charge = 87;
+  data.temperature = 2981;
+  data.status = 1;
+  data.cell_voltages[0] = 3325;
+  data.cell_voltages[1] = 3310;
+  data.cell_voltages[2] = 3330;
+  data.cell_voltages[3] = 3335;
+  this->hub_->notify(encode_frame(data));
+  this->hub_->update();
+  EXPECT_FLOAT_EQ(2.0f, this->min_voltage_cell_.state);
+
+  // The same pack with every cell reading 0, e.g. the balancer board unplugged
+  for (auto &cell : data.cell_voltages)
+    cell = 0;
+  esphome::testing::advance_millis(1000);
+  this->hub_->notify(encode_frame(data));
+  this->hub_->update();
+  EXPECT_TRUE(std::isnan(this->min_voltage_cell_.state));
+  EXPECT_TRUE(std::isnan(this->min_cell_voltage_.state));
+  EXPECT_TRUE(std::isnan(this->delta_cell_voltage_.state));
+}
+
+TEST(PublishFilter, ReportsTheSuppressedShare) {
+  esphome::testing::reset();
+  ble_client::BLEClient client;
+  TestHub hub{};
+  hub.set_client(&client);
+  sensor::Sensor voltage, suppression;
+  hub.set_voltage_sensor(&voltage);
+  hub.set_publish_filter(&voltage, 1.0f, 0.0f, 0);
+  hub.set_publish_suppression_sensor(&suppression);
+  hub.setup();
+  hub.connect();
+
+  auto records = load_corpus("charge_mtu247.log");
+  hub.notify(records[0].data);
+  hub.update();
+  EXPECT_FLOAT_EQ(0.0f, suppression.state);
+
+  // 2 mV is inside the deadband, the only publish of the interval is held back
+  hub.notify(records[1].data);
+  hub.update();
+  EXPECT_EQ(1u, voltage.publish_count);
+  EXPECT_FLOAT_EQ(100.0f, suppression.state);
+
+  // Nothing was published at all, which is not a ratio
+  hub.update();
+  EXPECT_EQ(2u, suppression.publish_count);
+}
+
+// Three hubs on one node: the local MTU is raised before any connection, to the largest
+// request, and connecting does not touch it or start a second exchange
+TEST(LocalMtu, IsRaisedOnceToTheLargestRequest) {
+  esphome::testing::reset();
+  TestHub::local_mtu_ = ESP_GATT_DEF_BLE_MTU_SIZE;
+  ble_client::BLEClient clients[3];
+  std::unique_ptr<TestHub> hubs[3];
+  const uint16_t mtus[3] = {185, 247, 100};
+  for (int i = 0; i < 3; i++) {
+    hubs[i] = std::make_unique<TestHub>();
+    hubs[i]->set_client(&clients[i]);
+    hubs[i]->set_mtu(mtus[i]);
+    hubs[i]->setup();
+    hubs[i]->registered();
+  }
+  EXPECT_EQ(247u, esphome::testing::local_mtu());
+  EXPECT_EQ(2u, esphome::testing::local_mtu_calls());
+
+  for (auto &hub : hubs)
+    hub->connect();
+  EXPECT_EQ(247u, esphome::testing::local_mtu());
+  EXPECT_EQ(2u, esphome::testing::local_mtu_calls());
+  EXPECT_EQ(0u, esphome::testing::mtu_requests());
+  EXPECT_EQ(ESP_GATT_DEF_BLE_MTU_SIZE, hubs[2]->negotiated_mtu_);
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
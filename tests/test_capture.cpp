@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include "support.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+static std::vector<CaptureRecord> parse(const std::vector<std::string> &lines, std::string *error = nullptr) {
+  CaptureDumpParser parser;
+  for (auto &line : lines) {
+    if (!parser.parse_line(line)) {
+      if (error != nullptr)
+        *error = parser.error();
+      return {};
+    }
+  }
+  if (error != nullptr)
+    *error = parser.complete() ? "" : "incomplete";
+  return parser.records();
+}
+
+TEST(CaptureBuffer, EvictsTheOldestRecords) {
+  CaptureBuffer capture;
+  capture.allocate(64);
+  uint8_t data[20];
+  for (uint8_t i = 0; i < 10; i++) {
+    memset(data, i, sizeof(data));
+    capture.record(1000 + i, data, sizeof(data));
+  }
+  // 26 bytes per record, two fit
+  ASSERT_EQ(2u, capture.size());
+  std::vector<uint32_t> timestamps;
+  capture.for_each([&](uint32_t timestamp, const uint8_t *record, uint16_t length) {
+    timestamps.push_back(timestamp);
+    EXPECT_EQ(20, length);
+    EXPECT_EQ(timestamp - 1000, record[19]);
+  });
+  EXPECT_EQ((std::vector<uint32_t>{1008, 1009}), timestamps);
+}
+
+TEST(CaptureDumpParser, ReadsTheLogFormat) {
+  std::string long_hex(128, 'a');
+  std::string rest(2 * 57, 'b');
+  auto records = parse({
+      "[12:00:01][I][kilovault_bms_ble:568]: capture begin 3 141",
+      "\033[0;32m[I][kilovault_bms_ble:571]: 1000 2 b030\033[0m",
+      "[I][kilovault_bms_ble:571]: 1003 121 " + long_hex,
+      "[I][kilovault_bms_ble:574]:   + " + rest,
+      "1006 0 ",
+      "[I][kilovault_bms_ble:577]: capture end",
+  });
+  ASSERT_EQ(3u, records.size());
+  EXPECT_EQ(1000u, records[0].timestamp);
+  EXPECT_EQ((std::vector<uint8_t>{0xB0, 0x30}), records[0].data);
+  ASSERT_EQ(121u, records[1].data.size());
+  EXPECT_EQ(0xAA, records[1].data[63]);
+  EXPECT_EQ(0xBB, records[1].data[64]);
+  EXPECT_TRUE(records[2].data.empty());
+}
+
+TEST(CaptureDumpParser, RejectsBrokenDumps) {
+  std::string error;
+  EXPECT_TRUE(parse({"capture begin 1 8", "1000 2 b030"}, &error).empty());
+  EXPECT_EQ("incomplete", error);
+
+  parse({"capture begin 2 16", "1000 2 b030", "capture end"}, &error);
+  EXPECT_EQ("capture end does not match capture begin", error);
+
+  parse({"capture begin 1 8", "1000 3 b030", "capture end"}, &error);
+  EXPECT_EQ("record of the wrong length", error);
+
+  parse({"capture begin 1 8", "1000 2 b0zz", "capture end"}, &error);
+  EXPECT_EQ("malformed hex", error);
+
+  parse({"capture begin 1 76", "1000 70 " + std::string(128, '0'), "capture end"}, &error);
+  EXPECT_EQ("record is missing its continuation lines", error);
+
+  parse({"capture begin 1 8", "  + b030"}, &error);
+  EXPECT_EQ("continuation without a record", error);
+}
+
+TEST(CaptureDumpParser, KeepsTheLastCapture) {
+  auto records = parse({
+      "capture begin 1 7",
+      "1000 1 b0",
+      "capture end",
+      "other log lines",
+      "capture begin 1 8",
+      "2000 2 b031",
+      "capture end",
+  });
+  ASSERT_EQ(1u, records.size());
+  EXPECT_EQ(2000u, records[0].timestamp);
+}
+
+TEST(CaptureDumpParser, RoundTripsTheCaptureBuffer) {
+  CaptureBuffer capture;
+  capture.allocate(1024);
+  std::vector<uint8_t> data(150);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = i * 7;
+  capture.record(5, data.data(), 150);
+  capture.record(9, data.data() + 3, 20);
+
+  // The lines dump_capture() logs
+  std::vector<std::string> lines{"capture begin " + std::to_string(capture.size()) + " " +
+                                 std::to_string(capture.used())};
+  capture.for_each([&lines](uint32_t timestamp, const uint8_t *record, uint16_t length) {
+    size_t first = std::min<size_t>(length, CaptureDumpParser::BYTES_PER_LINE);
+    lines.push_back(std::to_string(timestamp) + " " + std::to_string(length) + " " + format_hex(record, first));
+    for (size_t offset = first; offset < length; offset += CaptureDumpParser::BYTES_PER_LINE) {
+      size_t count = std::min<size_t>(length - offset, CaptureDumpParser::BYTES_PER_LINE);
+      lines.push_back("  + " + format_hex(record + offset, count));
+    }
+  });
+  lines.push_back("capture end");
+
+  auto records = parse(lines);
+  ASSERT_EQ(2u, records.size());
+  EXPECT_EQ(data, records[0].data);
+  EXPECT_EQ(std::vector<uint8_t>(data.begin() + 3, data.begin() + 23), records[1].data);
+}
+
+TEST(CaptureDumpParser, ReadsTheCorpus) {
+  EXPECT_EQ(70u, load_corpus("discharge_mtu23.log").size());
+  EXPECT_EQ(5u, load_corpus("charge_mtu247.log").size());
+  EXPECT_EQ(47u, load_corpus("noisy_mtu23.log").size());
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
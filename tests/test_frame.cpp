@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "support.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+static StatusData sample_status() {
+  StatusData data{};
+  data.voltage = 13312;
+  data.current = -1520;
+  data.total_capacity = 100000;
+  data.cycles = 12;
+  data.state_of_charge = 87;
+  data.temperature = 2981;
+  data.status = 1;
+  data.afe_status = 0x0102;
+  const uint16_t cells[] = {3321, 3325, 3330, 3324};
+  memcpy(data.cell_voltages, cells, sizeof(cells));
+  return data;
+}
+
+TEST(HexDecode, SwarMatchesScalarForEveryCharacterPair) {
+  // Every pair of characters in every position of a word, the rest of the word valid
+  for (int position = 0; position < 2; position++) {
+    for (int a = 0; a < 256; a++) {
+      for (int b = 0; b < 256; b++) {
+        uint8_t src[4] = {'3', 'c', '3', 'c'};
+        src[2 * position] = a;
+        src[2 * position + 1] = b;
+        uint8_t scalar[2], swar[2];
+        uint16_t scalar_sum = 0, swar_sum = 0;
+        bool scalar_valid = hex_decode_scalar(src, 2, scalar, scalar_sum);
+        bool swar_valid = hex_decode_swar(src, 2, swar, swar_sum);
+        ASSERT_EQ(scalar_valid, swar_valid) << a << " " << b;
+        if (scalar_valid) {
+          ASSERT_EQ(0, memcmp(scalar, swar, 2));
+          ASSERT_EQ(scalar_sum, swar_sum);
+        }
+      }
+    }
+  }
+}
+
+TEST(HexDecode, SumsAWholePayload) {
+  auto frame = encode_frame(sample_status());
+  uint8_t payload[KILOVAULT_PAYLOAD_SIZE];
+  uint16_t sum = 0;
+  ASSERT_TRUE(hex_decode_swar(frame.data() + 1, KILOVAULT_CHECKSUM_SIZE, payload, sum));
+  EXPECT_EQ(0x00, payload[0]);  // 13312 mV = 0x3400, low byte first
+  EXPECT_EQ(0x34, payload[1]);
+  uint16_t expected = 0;
+  for (uint8_t i = 0; i < KILOVAULT_CHECKSUM_SIZE; i++)
+    expected += payload[i];
+  EXPECT_EQ(expected, sum);
+}
+
+TEST(FrameDecoder, DecodesEveryFieldOfTheLayout) {
+  StatusData expected = sample_status();
+  auto frame = encode_frame(expected);
+  ASSERT_EQ(MAX_RESPONSE_SIZE, frame.size());
+
+  FrameDecoder<layout_v1::Layout> decoder;
+  decoder.reset();
+  decoder.advance(frame.data(), frame.size());
+  ASSERT_TRUE(decoder.complete());
+  ASSERT_TRUE(decoder.valid());
+  ASSERT_TRUE(decoder.checksum_ok());
+
+  const StatusData &data = decoder.data();
+  EXPECT_EQ(13312, data.voltage);
+  EXPECT_EQ(-1520, data.current);
+  EXPECT_EQ(100000u, data.total_capacity);
+  EXPECT_EQ(12, data.cycles);
+  EXPECT_EQ(87, data.state_of_charge);
+  EXPECT_EQ(2981, data.temperature);
+  EXPECT_EQ(1, data.status);
+  EXPECT_EQ(0x0102, data.afe_status);
+  for (uint8_t i = 0; i < CELL_COUNT; i++)
+    EXPECT_EQ(expected.cell_voltages[i], data.cell_voltages[i]);
+}
+
+TEST(FrameDecoder, ChunkBoundariesDoNotMatter) {
+  auto frame = encode_frame(sample_status());
+  FrameDecoder<layout_v1::Layout> whole;
+  whole.reset();
+  whole.advance(frame.data(), frame.size());
+
+  for (size_t chunk = 1; chunk <= frame.size(); chunk++) {
+    FrameDecoder<layout_v1::Layout> decoder;
+    decoder.reset();
+    for (size_t length = std::min(chunk, frame.size());; length = std::min(length + chunk, frame.size())) {
+      decoder.advance(frame.data(), length);
+      if (length == frame.size())
+        break;
+    }
+    ASSERT_TRUE(decoder.checksum_ok()) << chunk;
+    ASSERT_EQ(0, memcmp(whole.payload(), decoder.payload(), KILOVAULT_PAYLOAD_SIZE)) << chunk;
+    ASSERT_EQ(0, memcmp(&whole.data(), &decoder.data(), sizeof(StatusData))) << chunk;
+  }
+}
+
+TEST(FrameDecoder, FlagsBadFrames) {
+  auto frame = encode_frame(sample_status());
+
+  auto flipped = frame;
+  flipped[5] = flipped[5] == '7' ? '8' : '7';
+  FrameDecoder<layout_v1::Layout> decoder;
+  decoder.reset();
+  decoder.advance(flipped.data(), flipped.size());
+  EXPECT_TRUE(decoder.valid());
+  EXPECT_FALSE(decoder.checksum_ok());
+
+  auto non_hex = frame;
+  non_hex[31] = 'G';
+  decoder.reset();
+  decoder.advance(non_hex.data(), non_hex.size());
+  EXPECT_FALSE(decoder.valid());
+}
+
+TEST(FrameValues, DerivedInIntegers) {
+  StatusData data = sample_status();
+  EXPECT_EQ(-20234, frame_power_mw(data));  // 13.312 V * -1.52 A
+  EXPECT_EQ(87000u, frame_remaining_capacity_mah(data));
+  EXPECT_EQ(2495, frame_temperature_centi_celsius(data));  // 298.1 K
+
+  // The largest current a valid frame can carry does not overflow the power
+  data.voltage = UINT16_MAX;
+  data.current = INT32_MIN;
+  EXPECT_EQ(int64_t(UINT16_MAX) * INT32_MIN / 1000, frame_power_mw(data));
+}
+
+TEST(FrameValues, CellVoltageRange) {
+  StatusData data = sample_status();
+  CellVoltageRange range = frame_cell_voltage_range(data);
+  EXPECT_EQ(3321, range.min);
+  EXPECT_EQ(1, range.min_cell);
+  EXPECT_EQ(3330, range.max);
+  EXPECT_EQ(3, range.max_cell);
+
+  // A disconnected cell reads 0 and is left out of the minimum
+  data.cell_voltages[0] = 0;
+  range = frame_cell_voltage_range(data);
+  EXPECT_EQ(3324, range.min);
+  EXPECT_EQ(4, range.min_cell);
+
+  memset(data.cell_voltages, 0, sizeof(data.cell_voltages));
+  range = frame_cell_voltage_range(data);
+  EXPECT_EQ(0, range.min_cell);
+  EXPECT_EQ(0, range.max);
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "esphome/components/kilovault_bms_ble/kilovault_queue.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+// SpscRing with its counters set to where a long running node would have them
+class TestRing : public SpscRing {
+ public:
+  void set_position(uint32_t position) {
+    this->head_ = position;
+    this->tail_ = position;
+  }
+};
+
+// Record number n: its length and contents follow from n, so a consumer can check them
+static std::vector<uint8_t> record(uint32_t n) {
+  std::vector<uint8_t> data(4 + n * 7 % 180);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = uint8_t(n >> (8 * (i % 4))) ^ uint8_t(i);
+  return data;
+}
+
+static uint32_t record_number(const uint8_t *data) {
+  return data[0] | (data[1] ^ 1) << 8 | (data[2] ^ 2) << 16 | uint32_t(data[3] ^ 3) << 24;
+}
+
+TEST(SpscRingTest, RoundsTheCapacityUpToAPowerOfTwo) {
+  SpscRing ring;
+  ring.allocate(1000);
+  EXPECT_EQ(1024u, ring.capacity());
+  ring.allocate(2048);
+  EXPECT_EQ(2048u, ring.capacity());
+}
+
+TEST(SpscRingTest, KeepsRecordsIntactAcrossTheCounterWrap) {
+  for (size_t capacity : {1000u, 1024u, 1500u}) {
+    TestRing ring;
+    ring.allocate(capacity);
+    ring.set_position(UINT32_MAX - 300);
+    // Keeps a few records waiting, so the ring holds data while the counters wrap
+    std::vector<uint8_t> buffer(UINT16_MAX);
+    uint8_t *out = buffer.data();
+    uint32_t popped = 0;
+    for (uint32_t n = 0; n < 100; n++) {
+      auto data = record(n);
+      ASSERT_TRUE(ring.push(data.data(), data.size()));
+      if (n < 4)
+        continue;
+      data = record(popped);
+      ASSERT_EQ(int(data.size()), ring.pop(out));
+      ASSERT_EQ(popped, record_number(out)) << "capacity " << capacity;
+      ASSERT_TRUE(std::equal(data.begin(), data.end(), out));
+      popped++;
+    }
+    for (; popped < 100; popped++) {
+      ASSERT_GT(ring.pop(out), 0);
+      ASSERT_EQ(popped, record_number(out));
+    }
+    EXPECT_EQ(-1, ring.pop(out));
+  }
+}
+
+TEST(SpscRingTest, MarksOverflowsWithAGap) {
+  SpscRing ring;
+  ring.allocate(1024);
+  auto data = record(3);
+  size_t pushed = 0;
+  while (ring.push(data.data(), data.size()))
+    pushed++;
+  EXPECT_EQ(1u, ring.overflows());
+
+  uint8_t out[256];
+  for (size_t i = 0; i < pushed; i++)
+    ASSERT_EQ(int(data.size()), ring.pop(out));
+  EXPECT_EQ(-1, ring.pop(out));
+  ASSERT_TRUE(ring.push(data.data(), data.size()));
+  EXPECT_EQ(0, ring.pop(out));
+  EXPECT_EQ(int(data.size()), ring.pop(out));
+}
+
+// A producer and a consumer thread, the ring wrapping its counters on the way. Every
+// record arrives intact and in order, and every dropped one is marked by a gap.
+TEST(SpscRingTest, HandsOverRecordsBetweenThreads) {
+  static const uint32_t COUNT = 200000;
+  TestRing ring;
+  ring.allocate(1500);
+  ring.set_position(UINT32_MAX - 5000);
+
+  std::atomic<bool> done{false};
+  std::thread producer([&ring, &done]() {
+    for (uint32_t n = 0; n < COUNT; n++) {
+      auto data = record(n);
+      ring.push(data.data(), data.size());
+      if (n % 64 == 0)
+        std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  uint32_t received = 0, gaps = 0, expected = 0;
+  bool gap = false;
+  // Room for any length, even a corrupt one
+  std::vector<uint8_t> buffer(UINT16_MAX);
+  uint8_t *out = buffer.data();
+  std::string failure;
+  while (true) {
+    bool finished = done;
+    int length = ring.pop(out);
+    if (length < 0) {
+      if (finished)
+        break;
+      continue;
+    }
+    if (length == 0) {
+      gap = true;
+      gaps++;
+      continue;
+    }
+    uint32_t n = record_number(out);
+    auto data = record(n);
+    if (n < expected || (n != expected && !gap) || size_t(length) != data.size() ||
+        !std::equal(data.begin(), data.end(), out)) {
+      failure = "record " + std::to_string(n) + " after " + std::to_string(expected);
+      break;
+    }
+    expected = n + 1;
+    gap = false;
+    received++;
+  }
+  producer.join();
+
+  EXPECT_EQ("", failure);
+  EXPECT_EQ(COUNT, received + ring.overflows());
+  EXPECT_LE(gaps, ring.overflows());
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
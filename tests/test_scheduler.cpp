@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include "esphome/components/kilovault_scheduler/kilovault_scheduler.h"
+#include "support.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+using kilovault_scheduler::KilovaultScheduler;
+
+class SchedulerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    esphome::testing::reset();
+    for (int i = 0; i < 3; i++) {
+      this->clients_[i].set_address(0xAABBCCDDEE00ull + i);
+      this->hubs_[i].set_client(&this->clients_[i]);
+      this->scheduler_.add_battery(&this->hubs_[i]);
+    }
+    this->scheduler_.set_slot_timeout(10000);
+    this->scheduler_.set_cycle_interval(60000);
+  }
+
+  // Components are set up in order of priority, highest first, like App.setup() does
+  void setup_in_priority_order() {
+    ASSERT_LT(this->scheduler_.get_setup_priority(), setup_priority::AFTER_BLUETOOTH);
+    ASSERT_GT(this->hubs_[0].get_setup_priority(), setup_priority::AFTER_BLUETOOTH);
+    for (auto &hub : this->hubs_)
+      hub.setup();
+    for (auto &client : this->clients_)
+      client.set_enabled(true);  // ble_client's own setup
+    this->scheduler_.setup();
+  }
+
+  ble_client::BLEClient clients_[3];
+  TestHub hubs_[3]{};
+  KilovaultScheduler scheduler_;
+};
+
+TEST_F(SchedulerTest, OnlyTheFirstSlotConnectsOnBoot) {
+  this->setup_in_priority_order();
+  EXPECT_TRUE(this->clients_[0].enabled);
+  EXPECT_FALSE(this->clients_[1].enabled);
+  EXPECT_FALSE(this->clients_[2].enabled);
+  EXPECT_TRUE(this->hubs_[0].is_scheduled());
+}
+
+TEST_F(SchedulerTest, RotatesOnFramesAndTimeouts) {
+  this->setup_in_priority_order();
+  auto records = load_corpus("charge_mtu247.log");
+
+  this->hubs_[0].connect();
+  this->hubs_[0].notify(records[0].data);
+  this->scheduler_.run_scheduler();
+  EXPECT_FALSE(this->clients_[0].enabled);
+  EXPECT_TRUE(this->clients_[1].enabled);
+
+  // Battery 2 never answers
+  esphome::testing::advance_millis(10000);
+  this->scheduler_.run_scheduler();
+  EXPECT_FALSE(this->clients_[1].enabled);
+  EXPECT_TRUE(this->clients_[2].enabled);
+}
+
+TEST_F(SchedulerTest, EnergyIntegratesAcrossRotations) {
+  this->setup_in_priority_order();
+  // A rotation can take 3 slot timeouts or the cycle interval, plus one slot
+  EXPECT_EQ(70000u, this->hubs_[0].energy_.get_max_gap());
+
+  auto records = load_corpus("charge_mtu247.log");
+  for (int rotation = 0; rotation < 2; rotation++) {
+    this->hubs_[0].connect();
+    this->hubs_[0].notify(records[rotation].data);
+    this->hubs_[0].disconnect();
+    esphome::testing::advance_millis(60000);
+  }
+  EXPECT_EQ((25000 + 25100) * int64_t(60000), this->hubs_[0].energy_.totals.charge_in);
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "support.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+TEST(EnergyIntegrator, IntegratesTrapezoids) {
+  EnergyIntegrator energy;
+  energy.add(0, 1000, 13000);
+  energy.add(3600, 3000, 39000);  // 3.6 s from 1 A to 3 A, 2 mAh
+  EXPECT_FLOAT_EQ(0.002f, EnergyIntegrator::to_hours(energy.totals.charge_in));
+  EXPECT_FLOAT_EQ(0.026f, EnergyIntegrator::to_hours(energy.totals.energy_in));
+  EXPECT_EQ(0, energy.totals.charge_out);
+}
+
+TEST(EnergyIntegrator, SplitsAtTheZeroCrossing) {
+  EnergyIntegrator energy;
+  energy.add(0, 3000, 0);
+  energy.add(4000, -1000, 0);  // Crosses zero after 3 s
+  EXPECT_EQ(3000 * 3000, energy.totals.charge_in);
+  EXPECT_EQ(1000 * 1000, energy.totals.charge_out);
+}
+
+TEST(EnergyIntegrator, LargestFrameValuesDoNotOverflow) {
+  // 65535 mV at -2^31 mA, then the same power charging, a full hour apart
+  const int64_t power = int64_t(UINT16_MAX) * INT32_MIN / 1000;
+  EnergyIntegrator energy;
+  energy.set_max_gap(UINT32_MAX);
+  EXPECT_EQ(EnergyIntegrator::MAX_GAP_LIMIT, energy.get_max_gap());
+  energy.add(0, INT32_MIN, power);
+  energy.add(EnergyIntegrator::MAX_GAP_LIMIT, INT32_MAX, -power);
+  EXPECT_GT(energy.totals.energy_in, 0);
+  EXPECT_GT(energy.totals.energy_out, 0);
+  EXPECT_NEAR(double(energy.totals.energy_in), double(energy.totals.energy_out), 1.0);
+  EXPECT_NEAR(-power / 2.0 * EnergyIntegrator::MAX_GAP_LIMIT, double(energy.totals.energy_in), 1e6);
+
+  // Same sign, the whole trapezoid is exact integer math
+  int64_t before = energy.totals.energy_in;
+  energy.add(2 * EnergyIntegrator::MAX_GAP_LIMIT, INT32_MAX, -power);
+  EXPECT_EQ(before - 2 * power * int64_t(EnergyIntegrator::MAX_GAP_LIMIT), energy.totals.energy_in);
+}
+
+TEST(EnergyIntegrator, SkipsGaps) {
+  EnergyIntegrator energy;
+  energy.set_max_gap(5000);
+  energy.add(0, 1000, 0);
+  energy.add(6000, 1000, 0);
+  EXPECT_EQ(0, energy.totals.charge_in);
+  energy.add(7000, 1000, 0);
+  EXPECT_EQ(2000 * 1000, energy.totals.charge_in);
+
+  energy.restart();
+  energy.add(8000, 1000, 0);
+  EXPECT_EQ(2000 * 1000, energy.totals.charge_in);
+}
+
+TEST(EnergyIntegrator, HubRestartsOnDisconnect) {
+  esphome::testing::reset();
+  ble_client::BLEClient client;
+  TestHub hub{};
+  hub.set_client(&client);
+  hub.setup();
+  EXPECT_EQ(60000u, hub.energy_.get_max_gap());
+  hub.connect();
+
+  auto records = load_corpus("charge_mtu247.log");
+  esphome::testing::set_millis(1000);
+  hub.notify(records[0].data);
+  hub.disconnect();
+  hub.connect();
+  esphome::testing::set_millis(2000);
+  hub.notify(records[1].data);
+  EXPECT_EQ(0, hub.energy_.totals.charge_in);
+
+  esphome::testing::set_millis(3000);
+  hub.notify(records[2].data);
+  EXPECT_EQ((25100 + 25200) * 1000, hub.energy_.totals.charge_in);
+}
+
+TEST(EnergyIntegrator, MaxGapFollowsTheUpdateInterval) {
+  esphome::testing::reset();
+  ble_client::BLEClient client;
+  TestHub hub{};
+  hub.set_client(&client);
+  hub.set_update_interval(300000);
+  hub.setup();
+  EXPECT_EQ(600000u, hub.energy_.get_max_gap());
+
+  TestHub scheduled{};
+  scheduled.set_client(&client);
+  scheduled.set_energy_max_gap(900000);
+  scheduled.setup();
+  EXPECT_EQ(900000u, scheduled.energy_.get_max_gap());
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include "esphome/components/kilovault_bms_ble/switch/kilovault_switch.h"
+#include "support.h"
+
+namespace esphome {
+namespace kilovault_bms_ble {
+namespace testing {
+
+class SwitchTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    esphome::testing::reset();
+    this->hub_ = std::make_unique<TestHub>();
+    this->hub_->set_client(&this->client_);
+    this->hub_->set_command_retries(0);
+    this->charging_.set_parent(this->hub_.get());
+    this->discharging_.set_parent(this->hub_.get());
+    this->hub_->set_charging_switch(&this->charging_);
+    this->hub_->set_discharging_switch(&this->discharging_);
+    this->hub_->setup();
+  }
+
+  void enable_writes() {
+    this->hub_->set_write_command(0xA5);
+    this->charging_.set_holding_register(0x01);
+    this->discharging_.set_holding_register(0x02);
+  }
+
+  // The BMS acknowledging, or refusing, the write in flight
+  void acknowledge(esp_gatt_status_t status = ESP_GATT_OK) {
+    esp_ble_gattc_cb_param_t param{};
+    param.write.status = status;
+    param.write.handle = ble_client::BLEClient::COMMAND_HANDLE;
+    this->hub_->gattc_event_handler(ESP_GATTC_WRITE_CHAR_EVT, 3, &param);
+  }
+
+  std::vector<esphome::testing::GattWrite> command_writes() {
+    std::vector<esphome::testing::GattWrite> writes;
+    for (auto &write : esphome::testing::gatt_writes()) {
+      if (write.handle == ble_client::BLEClient::COMMAND_HANDLE)
+        writes.push_back(write);
+    }
+    return writes;
+  }
+
+  ble_client::BLEClient client_;
+  std::unique_ptr<TestHub> hub_;
+  KilovaultSwitch charging_, discharging_;
+};
+
+TEST_F(SwitchTest, IsReadOnlyWithoutAHoldingRegister) {
+  this->hub_->connect();
+  this->charging_.turn_on();
+  EXPECT_FALSE(this->charging_.state);
+  EXPECT_TRUE(this->command_writes().empty());
+  EXPECT_TRUE(this->hub_->command_queue_.empty());
+}
+
+TEST_F(SwitchTest, RefusesWritesWithoutAWriteCommand) {
+  this->charging_.set_holding_register(0x01);
+  this->hub_->connect();
+  this->charging_.turn_on();
+  EXPECT_FALSE(this->charging_.state);
+  EXPECT_TRUE(this->command_writes().empty());
+}
+
+TEST_F(SwitchTest, WritesEachSwitchToItsOwnRegister) {
+  this->enable_writes();
+  this->hub_->connect();
+  this->charging_.turn_on();
+  this->discharging_.turn_on();
+  EXPECT_EQ(2u, this->hub_->command_queue_.size());
+
+  auto writes = this->command_writes();
+  ASSERT_EQ(1u, writes.size());
+  EXPECT_EQ((std::vector<uint8_t>{0xA5, 0x16, 0x01, 0x01, 0x01, 0x19, 0x00, 0x52, 0x52}), writes[0].value);
+
+  this->acknowledge();
+  writes = this->command_writes();
+  ASSERT_EQ(2u, writes.size());
+  EXPECT_EQ((std::vector<uint8_t>{0xA5, 0x16, 0x02, 0x01, 0x01, 0x1A, 0x00, 0x52, 0x52}), writes[1].value);
+  this->acknowledge();
+  EXPECT_TRUE(this->charging_.state);
+  EXPECT_TRUE(this->discharging_.state);
+  EXPECT_TRUE(this->hub_->command_queue_.empty());
+}
+
+TEST_F(SwitchTest, RefusesValuesWiderThanAByte) {
+  this->enable_writes();
+  this->hub_->connect();
+  std::vector<bool> outcomes;
+  this->hub_->write_register(0x30, 0x1234, [&outcomes](bool success) { outcomes.push_back(success); });
+  EXPECT_EQ(std::vector<bool>{false}, outcomes);
+  EXPECT_TRUE(this->command_writes().empty());
+  EXPECT_TRUE(this->hub_->command_queue_.empty());
+}
+
+TEST_F(SwitchTest, RetriesARefusedWriteWithoutWaiting) {
+  this->enable_writes();
+  this->hub_->set_command_retries(2);
+  this->hub_->connect();
+  esphome::testing::fail_gatt_writes(1);
+  this->charging_.turn_on();
+  ASSERT_EQ(1u, this->command_writes().size());
+  this->acknowledge();
+  EXPECT_TRUE(this->charging_.state);
+  EXPECT_TRUE(this->hub_->command_queue_.empty());
+}
+
+TEST_F(SwitchTest, RollsBackToTheStateBeforeCoalescedWrites) {
+  this->enable_writes();
+  this->hub_->connect();
+  this->charging_.turn_on();     // In flight
+  this->charging_.turn_off();    // Waiting
+  this->charging_.turn_on();     // Coalesced into the waiting write
+  this->discharging_.turn_on();  // Another register, not coalesced
+  EXPECT_EQ(3u, this->hub_->command_queue_.size());
+
+  this->acknowledge();
+  this->acknowledge(ESP_GATT_ERROR);
+  EXPECT_TRUE(this->charging_.state);
+  this->acknowledge(ESP_GATT_ERROR);
+  EXPECT_FALSE(this->discharging_.state);
+  EXPECT_TRUE(this->hub_->command_queue_.empty());
+}
+
+TEST_F(SwitchTest, CoalescedWritesReportToEveryCaller) {
+  this->enable_writes();
+  this->hub_->connect();
+  std::vector<int> outcomes;
+  this->hub_->write_register(0x30, 1);
+  this->hub_->write_register(0x31, 1, [&outcomes](bool success) { outcomes.push_back(success ? 1 : -1); });
+  this->hub_->write_register(0x31, 2, [&outcomes](bool success) { outcomes.push_back(success ? 2 : -2); });
+  this->acknowledge();
+  this->acknowledge();
+  EXPECT_EQ((std::vector<int>{2, 1}), outcomes);
+  EXPECT_EQ(0x02, this->command_writes().back().value[4]);
+}
+
+}  // namespace testing
+}  // namespace kilovault_bms_ble
+}  // namespace esphome
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Receives and decodes the datagrams of the kilovault_exporter component.
+
+Prints one line per record. For a test against localhost, point the exporter (or any
+sender) at this machine and run:
+
+    python3 tools/kilovault_receiver.py --port 5489
+
+The layout is documented in components/kilovault_exporter/kilovault_exporter.h.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+
+MAGIC = 0x564B
+VERSION = 1
+
+HEADER = struct.Struct("<HBBBBH")
+RECORD = struct.Struct("<I6sHiHhhH")
+
+
+def decode(datagram):
+    """Returns the sequence number and the records of a datagram."""
+    if len(datagram) < HEADER.size:
+        raise ValueError(f"short datagram of {len(datagram)} bytes")
+    magic, version, cells, records, _, sequence = HEADER.unpack_from(datagram)
+    if magic != MAGIC:
+        raise ValueError(f"bad magic 0x{magic:04X}")
+    if version != VERSION:
+        raise ValueError(f"unsupported version {version}")
+
+    record_size = RECORD.size + 2 * cells
+    if len(datagram) < HEADER.size + records * record_size:
+        raise ValueError(f"truncated datagram, {records} records of {record_size} bytes")
+
+    decoded = []
+    for i in range(records):
+        offset = HEADER.size + i * record_size
+        timestamp, mac, voltage, current, soc, temperature, status, afe = RECORD.unpack_from(
+            datagram, offset
+        )
+        cell_voltages = struct.unpack_from(f"<{cells}H", datagram, offset + RECORD.size)
+        decoded.append({
+            "timestamp": timestamp,
+            "mac": ":".join(f"{b:02X}" for b in mac),
+            "voltage": voltage / 1000,
+            "current": current / 1000,
+            "state_of_charge": soc,
+            "temperature": round(temperature / 10 - 273.15, 1),
+            "status": status,
+            "afe_status": afe,
+            "cell_voltages": [v / 1000 for v in cell_voltages],
+        })
+    return sequence, decoded
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bind", default="0.0.0.0", help="address to listen on")
+    parser.add_argument("--port", type=int, default=5489, help="UDP port to listen on")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    print(f"Listening on {args.bind}:{args.port}", file=sys.stderr)
+
+    expected = {}
+    while True:
+        datagram, (host, _) = sock.recvfrom(2048)
+        try:
+            sequence, records = decode(datagram)
+        except ValueError as err:
+            print(f"{host}: {err}", file=sys.stderr)
+            continue
+
+        if host in expected and sequence != expected[host]:
+            print(f"{host}: lost {(sequence - expected[host]) & 0xFFFF} datagrams", file=sys.stderr)
+        expected[host] = (sequence + 1) & 0xFFFF
+        for record in records:
+            cells = " ".join(f"{v:.3f}" for v in record["cell_voltages"])
+            print(
+                f"{host} #{sequence} {record['timestamp']} {record['mac']} "
+                f"{record['voltage']:.3f} V {record['current']:.3f} A {record['state_of_charge']} % "
+                f"{record['temperature']} °C status {record['status']} afe 0x{record['afe_status']:04X} "
+                f"cells {cells}",
+                flush=True,
+            )
+
+
+if __name__ == "__main__":
+    main()